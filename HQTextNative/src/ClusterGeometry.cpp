@@ -0,0 +1,133 @@
+#include "ClusterGeometry.h"
+#include <algorithm>
+
+namespace HQText {
+
+ClusterGeometryView ViewClusterGeometry(const ClusterGeometry& geometry) {
+  ClusterGeometryView view;
+  view.clusterCount = (int)geometry.byteIndices.size();
+  view.lineCount = (int)geometry.lineFirstCluster.size();
+  view.inkRects = geometry.inkRects.data();
+  view.byteIndices = geometry.byteIndices.data();
+  view.left = geometry.left.data();
+  view.right = geometry.right.data();
+  view.rtl = geometry.rtl.data();
+  view.visualToLogical = geometry.visualToLogical.data();
+  view.logicalToVisual = geometry.logicalToVisual.data();
+  view.lineFirstCluster = geometry.lineFirstCluster.data();
+  view.lineTop = geometry.lineTop.data();
+  view.lineBottom = geometry.lineBottom.data();
+  return view;
+}
+
+int CopyClusterRects(const ClusterGeometry& geometry,
+                     PangoRectangle* rects,
+                     int count) {
+  int copied = std::min(count, (int)geometry.inkRects.size());
+  std::copy(geometry.inkRects.begin(), geometry.inkRects.begin() + copied,
+            rects);
+  for (int c = copied; c < count; c++) {
+    rects[c] = PangoRectangle{0, 0, 0, 0};
+  }
+  return copied;
+}
+
+// lineEnd returns the cluster after the last one of line.
+static int lineEnd(const ClusterGeometry& geometry, int line) {
+  return line + 1 < (int)geometry.lineFirstCluster.size()
+             ? geometry.lineFirstCluster[line + 1]
+             : (int)geometry.byteIndices.size();
+}
+
+// lineOfCluster returns the line holding cluster.
+static int lineOfCluster(const ClusterGeometry& geometry, int cluster) {
+  auto it = std::upper_bound(geometry.lineFirstCluster.begin(),
+                             geometry.lineFirstCluster.end(), cluster);
+  return std::max((int)(it - geometry.lineFirstCluster.begin()) - 1, 0);
+}
+
+int HitTestClusters(const ClusterGeometry& geometry, int x, int y) {
+  if (geometry.byteIndices.empty() || geometry.lineFirstCluster.empty()) {
+    return -1;
+  }
+  // The first line reaching below y, or the last line.
+  auto lineIt = std::upper_bound(geometry.lineBottom.begin(),
+                                 geometry.lineBottom.end(), y);
+  int line = std::min((int)(lineIt - geometry.lineBottom.begin()),
+                      (int)geometry.lineBottom.size() - 1);
+  int first = geometry.lineFirstCluster[line];
+  int end = lineEnd(geometry, line);
+  if (first == end) {
+    return -1;
+  }
+  // The first visual position whose right edge is beyond x, or the last one.
+  const std::vector<int>& order = geometry.visualToLogical;
+  auto visualIt = std::partition_point(
+      order.begin() + first, order.begin() + end,
+      [&](int cluster) { return geometry.right[cluster] <= x; });
+  if (visualIt == order.begin() + end) {
+    --visualIt;
+  }
+  return *visualIt;
+}
+
+bool ClusterCaretRect(const ClusterGeometry& geometry,
+                      int cluster,
+                      PangoRectangle* rect) {
+  if (cluster < 0 || cluster >= (int)geometry.byteIndices.size()) {
+    return false;
+  }
+  int line = lineOfCluster(geometry, cluster);
+  rect->x = geometry.rtl[cluster] ? geometry.right[cluster]
+                                  : geometry.left[cluster];
+  rect->y = geometry.lineTop[line];
+  rect->width = 0;
+  rect->height = geometry.lineBottom[line] - geometry.lineTop[line];
+  return true;
+}
+
+int ClusterSelectionRects(const ClusterGeometry& geometry,
+                          int start,
+                          int end,
+                          PangoRectangle* rects,
+                          int capacity) {
+  int clusterCount = (int)geometry.byteIndices.size();
+  start = std::max(start, 0);
+  end = std::min(end, clusterCount);
+  if (start >= end) {
+    return 0;
+  }
+  int count = 0;
+  for (int line = lineOfCluster(geometry, start);
+       line < (int)geometry.lineFirstCluster.size() &&
+       geometry.lineFirstCluster[line] < end;
+       ++line) {
+    // Merge the selected clusters that are next to each other on screen.
+    bool open = false;
+    PangoRectangle span = {};
+    for (int v = geometry.lineFirstCluster[line]; v < lineEnd(geometry, line);
+         ++v) {
+      int cluster = geometry.visualToLogical[v];
+      bool selected = cluster >= start && cluster < end;
+      if (selected && !open) {
+        span.x = geometry.left[cluster];
+        span.y = geometry.lineTop[line];
+        span.height = geometry.lineBottom[line] - geometry.lineTop[line];
+        open = true;
+      }
+      if (selected) {
+        span.width = geometry.right[cluster] - span.x;
+      }
+      if (open && (!selected || v + 1 == lineEnd(geometry, line))) {
+        if (count < capacity) {
+          rects[count] = span;
+        }
+        count++;
+        open = false;
+      }
+    }
+  }
+  return count;
+}
+
+}  // namespace HQText
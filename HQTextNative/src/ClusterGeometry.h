@@ -0,0 +1,86 @@
+#ifndef HQTEXT_CLUSTERGEOMETRY_H
+#define HQTEXT_CLUSTERGEOMETRY_H
+
+#include <pango/pango.h>
+#include <vector>
+
+namespace HQText {
+
+// ClusterGeometry indexes where the clusters of a layout are drawn, in surface
+// pixels with y pointing down. It is built once per layout and never modified,
+// so queries don't need pango or the lane's mutex.
+//
+// Clusters are numbered in logical order: by line, and by their position in the
+// text within a line. Each paragraph also ends with a zero width cluster for
+// its line break, or for the end of the text, so that there is one cluster per
+// character in simple text and a caret position after the last character.
+struct ClusterGeometry {
+  // Per cluster.
+  std::vector<PangoRectangle> inkRects;
+  std::vector<int> byteIndices;
+  // The logical horizontal extent.
+  std::vector<int> left;
+  std::vector<int> right;
+  // Whether the cluster belongs to a right to left run.
+  std::vector<unsigned char> rtl;
+  // The cluster at each visual position. Lines hold the same range of
+  // positions in both orders, and visual positions run left to right.
+  std::vector<int> visualToLogical;
+  std::vector<int> logicalToVisual;
+
+  // Per line. Line i holds clusters lineFirstCluster[i] up to
+  // lineFirstCluster[i + 1], or the cluster count for the last line. The
+  // vertical ranges include the line spacing, so they don't leave gaps.
+  std::vector<int> lineFirstCluster;
+  std::vector<int> lineTop;
+  std::vector<int> lineBottom;
+};
+
+// ClusterGeometryView exposes the arrays of a label's ClusterGeometry without
+// copying them. The pointers stay valid until the next update or teardown of
+// the label.
+struct ClusterGeometryView {
+  int clusterCount;
+  int lineCount;
+  const PangoRectangle* inkRects;
+  const int* byteIndices;
+  const int* left;
+  const int* right;
+  const unsigned char* rtl;
+  const int* visualToLogical;
+  const int* logicalToVisual;
+  const int* lineFirstCluster;
+  const int* lineTop;
+  const int* lineBottom;
+};
+
+ClusterGeometryView ViewClusterGeometry(const ClusterGeometry& geometry);
+
+// CopyClusterRects copies the ink rects of the first count clusters to rects,
+// zeroing any rects beyond the last cluster, and returns how many it copied.
+int CopyClusterRects(const ClusterGeometry& geometry,
+                     PangoRectangle* rects,
+                     int count);
+
+// HitTestClusters returns the cluster under (x, y), taking the closest line and
+// the closest cluster in it for points outside the text, or -1 if the layout
+// has no clusters.
+int HitTestClusters(const ClusterGeometry& geometry, int x, int y);
+
+// ClusterCaretRect returns the zero width caret in front of cluster, on the
+// cluster's leading edge in its run direction.
+bool ClusterCaretRect(const ClusterGeometry& geometry,
+                      int cluster,
+                      PangoRectangle* rect);
+
+// ClusterSelectionRects writes up to capacity rects covering clusters start up
+// to end, one per visually contiguous span on each line, and returns how many
+// rects the selection needs.
+int ClusterSelectionRects(const ClusterGeometry& geometry,
+                          int start,
+                          int end,
+                          PangoRectangle* rects,
+                          int capacity);
+
+}  // namespace HQText
+#endif  // HQTEXT_CLUSTERGEOMETRY_H
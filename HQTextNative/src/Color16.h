@@ -4,6 +4,8 @@
 #include <glibconfig.h>
 
 namespace HQText {
+// Color16 is a pixel with 16 bits per channel, e.g. the half floats of an
+// RGBAHalf texture.
 struct Color16 {
   guint16 r;
   guint16 g;
@@ -0,0 +1,118 @@
+#include "DistanceField.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace HQText {
+
+// Far enough that any distance on a texture is smaller, small enough that
+// sums of it stay finite.
+static const float far = 1e20f;
+
+// transform1D replaces the length samples of grid, stride apart, with their
+// squared distance transform, using the lower envelope of parabolas from
+// Felzenszwalb and Huttenlocher's "Distance Transforms of Sampled Functions".
+// f, v and z are scratch space for length, length and length + 1 entries.
+static void transform1D(float* grid,
+                        int stride,
+                        int length,
+                        float* f,
+                        int* v,
+                        float* z) {
+  v[0] = 0;
+  z[0] = -far;
+  z[1] = far;
+  f[0] = grid[0];
+  int k = 0;
+  for (int q = 1; q < length; ++q) {
+    f[q] = grid[(size_t)q * stride];
+    float q2 = (float)q * q;
+    // Drop the parabolas the new one is below from their start onwards.
+    float s;
+    do {
+      int r = v[k];
+      s = (f[q] - f[r] + q2 - (float)r * r) / (q - r) / 2;
+    } while (s <= z[k] && --k > -1);
+    k++;
+    v[k] = q;
+    z[k] = s;
+    z[k + 1] = far;
+  }
+  k = 0;
+  for (int q = 0; q < length; ++q) {
+    while (z[k + 1] < q) {
+      k++;
+    }
+    int r = v[k];
+    float d = (float)(q - r);
+    grid[(size_t)q * stride] = f[r] + d * d;
+  }
+}
+
+static void transform2D(float* grid,
+                        int width,
+                        int height,
+                        float* f,
+                        int* v,
+                        float* z) {
+  for (int x = 0; x < width; ++x) {
+    transform1D(grid + x, width, height, f, v, z);
+  }
+  for (int y = 0; y < height; ++y) {
+    transform1D(grid + (size_t)y * width, 1, width, f, v, z);
+  }
+}
+
+void ComputeDistanceField(unsigned char* data,
+                          int stride,
+                          int width,
+                          int height,
+                          float spread) {
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+  size_t count = (size_t)width * height;
+  // outside holds the squared distance to the glyphs, inside the squared
+  // distance to the background. Partly covered pixels start at the subpixel
+  // distance of the edge implied by their coverage.
+  static thread_local std::vector<float> outside, inside, f, z;
+  static thread_local std::vector<int> v;
+  outside.assign(count, far);
+  inside.assign(count, 0.0f);
+  int length = std::max(width, height);
+  f.resize(length);
+  v.resize(length);
+  z.resize(length + 1);
+
+  for (int y = 0; y < height; ++y) {
+    const unsigned char* row = data + (size_t)y * stride;
+    for (int x = 0; x < width; ++x) {
+      size_t i = (size_t)y * width + x;
+      unsigned char a = row[x];
+      if (a == 255) {
+        outside[i] = 0.0f;
+        inside[i] = far;
+      } else if (a > 0) {
+        float d = 0.5f - a / 255.0f;
+        outside[i] = d > 0 ? d * d : 0.0f;
+        inside[i] = d < 0 ? d * d : 0.0f;
+      }
+    }
+  }
+  transform2D(outside.data(), width, height, f.data(), v.data(), z.data());
+  transform2D(inside.data(), width, height, f.data(), v.data(), z.data());
+
+  float scale = 1.0f / (2.0f * std::max(spread, 1.0f));
+  for (int y = 0; y < height; ++y) {
+    unsigned char* row = data + (size_t)y * stride;
+    for (int x = 0; x < width; ++x) {
+      size_t i = (size_t)y * width + x;
+      float d = std::sqrt(outside[i]) - std::sqrt(inside[i]);
+      float value = 0.5f - d * scale;
+      value = std::min(std::max(value, 0.0f), 1.0f);
+      row[x] = (unsigned char)(value * 255.0f + 0.5f);
+    }
+  }
+}
+
+}  // namespace HQText
@@ -0,0 +1,22 @@
+#ifndef HQTEXT_DISTANCEFIELD_H
+#define HQTEXT_DISTANCEFIELD_H
+
+namespace HQText {
+
+// The default distance, in pixels, over which a distance field falls from
+// fully inside to fully outside the glyphs.
+const float DefaultDistanceFieldSpread = 8.0f;
+
+// ComputeDistanceField turns an A8 coverage image into a signed distance
+// field, in place. Each byte becomes 0.5 - d / (2 * spread), where d is the
+// distance in pixels to the glyph edge, negative inside. The edge, which is
+// taken from the coverage at subpixel precision, maps to 0.5 and anything
+// spread pixels away saturates. It runs in time linear in the pixel count.
+void ComputeDistanceField(unsigned char* data,
+                          int stride,
+                          int width,
+                          int height,
+                          float spread);
+
+}  // namespace HQText
+#endif  // HQTEXT_DISTANCEFIELD_H
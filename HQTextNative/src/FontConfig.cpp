@@ -5,16 +5,29 @@
 #include <vector>
 #include "Unity/IUnityInterface.h"
 #include "DefaultFontConfig.h"
+#include "FontMapPool.h"
+#include "FontMetricsCache.h"
+#include "FontRegistry.h"
+#include "TextSizeCache.h"
 
 namespace HQText {
 static FcConfig* fontConfig = nullptr;
 std::mutex configMutex;
 
+// fontsChanged drops everything cached from the previous font set.
+static void fontsChanged() {
+  ResetFontMapPool();
+  ResetFontRegistry();
+  ClearTextSizeCache();
+  ClearFontMetricsCache();
+}
+
 void setConfig(FcConfig* config) {
   configMutex.lock();
   fontConfig = config;
   FcConfigSetCurrent(fontConfig);
   configMutex.unlock();
+  fontsChanged();
 }
 
 extern "C" UNITY_INTERFACE_EXPORT FcBool FontConfigInitialized() {
@@ -26,6 +39,7 @@ extern "C" UNITY_INTERFACE_EXPORT void DeinitializeFontConfig() {
     FcConfigDestroy(fontConfig);
     fontConfig = nullptr;
     configMutex.unlock();
+    fontsChanged();
   }
 }
 
@@ -51,7 +65,10 @@ extern "C" UNITY_INTERFACE_EXPORT bool InitializeFontConfig(
 
 extern "C" UNITY_INTERFACE_EXPORT FcBool AddFontDir(const char* dirPath) {
     FcConfigAppFontClear(FcConfigGetCurrent());
-  return FcConfigAppFontAddDir(FcConfigGetCurrent(), (FcChar8*)dirPath);
+  FcBool result = FcConfigAppFontAddDir(FcConfigGetCurrent(), (FcChar8*)dirPath);
+  // Shared font maps and the font registry cache the old font set.
+  fontsChanged();
+  return result;
 }
 
 extern "C" UNITY_INTERFACE_EXPORT PangoFontFamily** GetAvailableFontFamilies(
@@ -70,44 +87,7 @@ extern "C" UNITY_INTERFACE_EXPORT PangoFontDescription*
 GetFontDescriptionFromString(char* family,
                              char* face,
                              _cairo_font_type backendType) {
-  // Get the list of font families
-  PangoFontFamily** families;
-  int n_families;
-
-  auto fontMap = pango_cairo_font_map_new_for_font_type(backendType);
-  pango_font_map_list_families(fontMap, &families, &n_families);
-
-  PangoFontDescription* description = nullptr;
-
-  // Find the desired font family
-  for (int i = 0; i < n_families; i++) {
-    const char* family_name = pango_font_family_get_name(families[i]);
-    if (strcmp(family_name, family) == 0) {
-      // Find the desired font face
-      PangoFontFace** faces;
-      int n_faces;
-      pango_font_family_list_faces(families[i], &faces, &n_faces);
-
-      for (int j = 0; j < n_faces; j++) {
-        const char* face_name = pango_font_face_get_face_name(faces[j]);
-        if (strcmp(face_name, face) == 0) {
-          // Get the font description for the desired font face
-          description = pango_font_face_describe(faces[j]);
-          break;
-        }
-      }
-
-      // Free the font faces array
-      g_free(faces);
-      break;
-    }
-  }
-
-  // Free the font families array
-  g_free(families);
-  g_object_unref(fontMap);
-
-  return description;
+  return LookupFontDescription(family, face, backendType);
 }
 
 extern "C" UNITY_INTERFACE_EXPORT PangoFontFace** GetAvailableFontFacesAtIndex(
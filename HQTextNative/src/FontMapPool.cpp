@@ -0,0 +1,91 @@
+#include "FontMapPool.h"
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility>
+
+namespace HQText {
+
+typedef std::pair<int, _cairo_font_type> FontMapKey;
+typedef std::tuple<int, _cairo_font_type, PangoDirection, cairo_antialias_t>
+    ContextKey;
+
+static std::map<FontMapKey, PangoFontMap*> fontMaps = {};
+static std::map<ContextKey, PangoContext*> contexts = {};
+static std::mutex poolMutex;
+static std::mutex laneMutexes[FontMapLaneCount];
+
+std::mutex& FontMapLaneMutex(int lane) {
+  return laneMutexes[lane];
+}
+
+static PangoFontMap* getFontMapLocked(_cairo_font_type ft, int lane) {
+  FontMapKey key = std::make_pair(lane, ft);
+  auto it = fontMaps.find(key);
+  if (it != fontMaps.end()) {
+    return it->second;
+  }
+  PangoFontMap* fontMap = pango_cairo_font_map_new_for_font_type(ft);
+  if (fontMap == nullptr) {
+    printf("Could not create font map for font type %d\n", (int)ft);
+    return nullptr;
+  }
+  fontMaps[key] = fontMap;
+  return fontMap;
+}
+
+PangoFontMap* AcquireFontMap(_cairo_font_type ft, int lane) {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  PangoFontMap* fontMap = getFontMapLocked(ft, lane);
+  if (fontMap != nullptr) {
+    g_object_ref(fontMap);
+  }
+  return fontMap;
+}
+
+PangoContext* AcquireContext(_cairo_font_type ft,
+                             PangoDirection dir,
+                             cairo_antialias_t antialias,
+                             int lane) {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  ContextKey key = std::make_tuple(lane, ft, dir, antialias);
+  auto it = contexts.find(key);
+  if (it != contexts.end()) {
+    g_object_ref(it->second);
+    return it->second;
+  }
+
+  PangoFontMap* fontMap = getFontMapLocked(ft, lane);
+  if (fontMap == nullptr) {
+    return nullptr;
+  }
+  PangoContext* context = pango_font_map_create_context(fontMap);
+
+  // Disable ClearType antialiasing
+  // TODO: only do this for win32 as it doesn't seem to affect FreeType (perhaps due to setting on font.conf?)
+  {
+    auto font_options = cairo_font_options_create();
+    cairo_font_options_set_antialias(font_options, antialias);
+    pango_cairo_context_set_font_options(context, font_options);
+    cairo_font_options_destroy(font_options);
+  }
+  pango_context_set_base_dir(context, dir);
+
+  contexts[key] = context;
+  g_object_ref(context);
+  return context;
+}
+
+void ResetFontMapPool() {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  for (auto& entry : contexts) {
+    g_object_unref(entry.second);
+  }
+  contexts.clear();
+  for (auto& entry : fontMaps) {
+    g_object_unref(entry.second);
+  }
+  fontMaps.clear();
+}
+
+}  // namespace HQText
@@ -0,0 +1,40 @@
+#ifndef HQTEXT_FONTMAPPOOL_H
+#define HQTEXT_FONTMAPPOOL_H
+
+#include <cairo.h>
+#include <pango/pango.h>
+#include <pango/pangocairo.h>
+#include <mutex>
+
+namespace HQText {
+
+// Pango font maps aren't thread safe, so the pool keeps a separate set of font
+// maps and contexts per lane, and different lanes can shape text in parallel.
+// Pango objects from a lane must only be used with FontMapLaneMutex(lane)
+// held. Lane 0 is used by the synchronous API, the others by the layout
+// workers.
+const int FontMapLaneCount = 9;
+
+std::mutex& FontMapLaneMutex(int lane);
+
+// AcquireFontMap returns a new reference to the lane's font map for the given
+// backend. Release it with g_object_unref.
+PangoFontMap* AcquireFontMap(_cairo_font_type ft, int lane = 0);
+
+// AcquireContext returns a new reference to a shared context created from the
+// backend's font map, configured with the given base direction and antialias
+// mode. Layouts created from it share the font map's fontconfig pattern and
+// scaled font caches. Release it with g_object_unref, and never change its
+// settings as other layouts depend on them.
+PangoContext* AcquireContext(_cairo_font_type ft,
+                             PangoDirection dir,
+                             cairo_antialias_t antialias = CAIRO_ANTIALIAS_GRAY,
+                             int lane = 0);
+
+// ResetFontMapPool drops the pool's references so the next acquire creates
+// fresh font maps, picking up font config changes. Objects already handed out
+// stay valid until their owners release them.
+void ResetFontMapPool();
+
+}  // namespace HQText
+#endif  // HQTEXT_FONTMAPPOOL_H
@@ -0,0 +1,158 @@
+#include "FontMetricsCache.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include "FontRegistry.h"
+
+namespace HQText {
+
+struct FontMetricsKey {
+  int fontId;
+  int size;
+  // Interned by pango, so languages compare by pointer.
+  PangoLanguage* language;
+  _cairo_font_type backend;
+
+  bool operator==(const FontMetricsKey& other) const {
+    return fontId == other.fontId && size == other.size &&
+           language == other.language && backend == other.backend;
+  }
+};
+
+struct FontMetricsKeyHash {
+  size_t operator()(const FontMetricsKey& key) const {
+    size_t h = (size_t)key.fontId * 0x9E3779B97F4A7C15ull;
+    h ^= (size_t)key.size * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+    h ^= std::hash<PangoLanguage*>()(key.language) + (h << 6);
+    return h ^ (size_t)key.backend;
+  }
+};
+
+static std::unordered_map<FontMetricsKey, FontMetrics, FontMetricsKeyHash>
+    lineMetrics = {};
+static std::unordered_map<int, FontInkBounds> inkBounds = {};
+static std::mutex fontMetricsMutex;
+
+// The font id the context's default font is cached under.
+static const int contextFontId = -1;
+
+// getFontMetrics returns the cached metrics for key, measuring desc in context
+// if they aren't cached. A null desc measures the context's default font.
+static FontMetrics getFontMetrics(const FontMetricsKey& key,
+                                  PangoContext* context,
+                                  const PangoFontDescription* desc) {
+  {
+    std::lock_guard<std::mutex> lock(fontMetricsMutex);
+    auto it = lineMetrics.find(key);
+    if (it != lineMetrics.end()) {
+      return it->second;
+    }
+  }
+  // pango measures a sample text of the language, so this is worth caching.
+  FontMetrics result = {0, 0, 0, 0};
+  PangoFontMetrics* metrics = pango_context_get_metrics(context, desc, nullptr);
+  if (metrics) {
+    result.ascent = pango_font_metrics_get_ascent(metrics);
+    result.descent = pango_font_metrics_get_descent(metrics);
+    result.height = pango_font_metrics_get_height(metrics);
+    result.approximateCharWidth =
+        pango_font_metrics_get_approximate_char_width(metrics);
+    pango_font_metrics_unref(metrics);
+  }
+  std::lock_guard<std::mutex> lock(fontMetricsMutex);
+  lineMetrics[key] = result;
+  return result;
+}
+
+FontMetrics GetFontMetrics(int fontId,
+                           PangoContext* context,
+                           const PangoFontDescription* desc) {
+  FontMetricsKey key = {fontId, pango_font_description_get_size(desc),
+                        pango_context_get_language(context),
+                        GetRegisteredFontBackend(fontId)};
+  return getFontMetrics(key, context, desc);
+}
+
+FontMetrics GetContextFontMetrics(PangoContext* context) {
+  PangoFontMap* fontMap = pango_context_get_font_map(context);
+  FontMetricsKey key = {
+      contextFontId,
+      pango_font_description_get_size(
+          pango_context_get_font_description(context)),
+      pango_context_get_language(context),
+      pango_cairo_font_map_get_font_type(PANGO_CAIRO_FONT_MAP(fontMap))};
+  return getFontMetrics(key, context, nullptr);
+}
+
+// readInt16 reads a big endian signed 16 bit value from a font table.
+static int readInt16(const char* data, unsigned int length, unsigned int offset) {
+  if (offset + 2 > length) {
+    return 0;
+  }
+  return (int16_t)(((uint8_t)data[offset] << 8) | (uint8_t)data[offset + 1]);
+}
+
+// measureInkBounds reads the bounds from the face's header tables in font
+// units, so the bounds don't depend on the size or hinting, and large faces
+// cost no more than small ones. hhea holds the smallest left and right side
+// bearings of any glyph, and head the bounding box of all glyphs.
+static FontInkBounds measureInkBounds(PangoContext* context,
+                                      const PangoFontDescription* desc) {
+  FontInkBounds bounds = {0, 0, 0, 0};
+  PangoFont* font = pango_context_load_font(context, desc);
+  if (font == nullptr) {
+    return bounds;
+  }
+  hb_face_t* face = hb_font_get_face(pango_font_get_hb_font(font));
+  hb_blob_t* head = hb_face_reference_table(face, HB_TAG('h', 'e', 'a', 'd'));
+  hb_blob_t* hhea = hb_face_reference_table(face, HB_TAG('h', 'h', 'e', 'a'));
+  unsigned int headLength;
+  unsigned int hheaLength;
+  const char* headData = hb_blob_get_data(head, &headLength);
+  const char* hheaData = hb_blob_get_data(hhea, &hheaLength);
+  int ascender = readInt16(hheaData, hheaLength, 4);
+  int descender = readInt16(hheaData, hheaLength, 6);
+  int minLeftSideBearing = readInt16(hheaData, hheaLength, 12);
+  int minRightSideBearing = readInt16(hheaData, hheaLength, 14);
+  int yMin = readInt16(headData, headLength, 38);
+  int yMax = readInt16(headData, headLength, 42);
+  float upem = (float)std::max(hb_face_get_upem(face), 1u);
+  hb_blob_destroy(head);
+  hb_blob_destroy(hhea);
+  g_object_unref(font);
+
+  bounds.left = std::max(-minLeftSideBearing, 0) / upem;
+  bounds.right = std::max(-minRightSideBearing, 0) / upem;
+  // y points up, and the descender is negative.
+  bounds.top = std::max(yMax - ascender, 0) / upem;
+  bounds.bottom = std::max(descender - yMin, 0) / upem;
+  return bounds;
+}
+
+FontInkBounds GetFontInkBounds(int fontId,
+                               PangoContext* context,
+                               const PangoFontDescription* desc) {
+  {
+    std::lock_guard<std::mutex> lock(fontMetricsMutex);
+    auto it = inkBounds.find(fontId);
+    if (it != inkBounds.end()) {
+      return it->second;
+    }
+  }
+  // Measure outside the lock, so other lanes aren't held up. Two lanes may
+  // measure the same font at once, which is harmless.
+  FontInkBounds bounds = measureInkBounds(context, desc);
+  std::lock_guard<std::mutex> lock(fontMetricsMutex);
+  inkBounds[fontId] = bounds;
+  return bounds;
+}
+
+void ClearFontMetricsCache() {
+  std::lock_guard<std::mutex> lock(fontMetricsMutex);
+  lineMetrics.clear();
+  inkBounds.clear();
+}
+
+}  // namespace HQText
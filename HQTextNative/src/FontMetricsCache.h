@@ -0,0 +1,53 @@
+#ifndef HQTEXT_FONTMETRICSCACHE_H
+#define HQTEXT_FONTMETRICSCACHE_H
+
+#include <cairo.h>
+#include <pango/pango.h>
+#include <pango/pangocairo.h>
+
+namespace HQText {
+
+// FontInkBounds is how far the glyphs of a font reach outside the logical
+// boxes of the lines they are laid out in, in ems: left of the origin, right
+// of the advance, above the ascent and below the descent.
+struct FontInkBounds {
+  float left;
+  float right;
+  float top;
+  float bottom;
+};
+
+// FontMetrics are the line metrics of a font at one size, in pango units.
+struct FontMetrics {
+  int ascent;
+  int descent;
+  int height;
+  int approximateCharWidth;
+};
+
+// GetFontMetrics returns the metrics pango_context_get_metrics reports for the
+// registered font at desc's absolute size and the context's language. They are
+// shared by every label using the same font, size, language and backend. The
+// caller must hold the context's lane mutex.
+FontMetrics GetFontMetrics(int fontId,
+                           PangoContext* context,
+                           const PangoFontDescription* desc);
+
+// GetContextFontMetrics returns the metrics of the context's default font,
+// which line spacing is measured from rather than the label's font. They are
+// shared like GetFontMetrics, and the same lane rule applies.
+FontMetrics GetContextFontMetrics(PangoContext* context);
+
+// GetFontInkBounds returns the worst case ink bounds of any glyph in the
+// registered font, as the font's header tables report them. They are read
+// once and shared by all sizes and labels. desc must describe the font, and
+// context must be used with its lane's mutex held, which the caller must hold.
+FontInkBounds GetFontInkBounds(int fontId,
+                               PangoContext* context,
+                               const PangoFontDescription* desc);
+
+// ClearFontMetricsCache drops every cached font, e.g. when the fonts change.
+void ClearFontMetricsCache();
+
+}  // namespace HQText
+#endif  // HQTEXT_FONTMETRICSCACHE_H
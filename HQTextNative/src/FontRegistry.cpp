@@ -0,0 +1,190 @@
+#include "FontRegistry.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FontMapPool.h"
+
+namespace HQText {
+
+struct RegisteredFont {
+  std::string family;
+  std::string face;
+  _cairo_font_type backendType;
+  PangoFontDescription* description = nullptr;
+  bool resolved = false;
+};
+
+typedef std::unordered_map<std::string, PangoFontDescription*> FaceIndex;
+
+static std::vector<RegisteredFont> registeredFonts = {};
+static std::unordered_map<std::string, int> registeredFontIds = {};
+static std::map<_cairo_font_type, FaceIndex> faceIndices = {};
+static std::mutex registryMutex;
+
+static std::string fontKey(const std::string& family, const std::string& face) {
+  std::string key = family;
+  key += '\x1f';
+  key += face;
+  return key;
+}
+
+// getFaceIndexLocked lists every family and face of the backend once, so lookups
+// afterwards are a single hash map access. The listing uses the lane's font
+// map, so the caller must hold FontMapLaneMutex(lane) as well as the registry
+// mutex.
+static FaceIndex& getFaceIndexLocked(_cairo_font_type backendType, int lane) {
+  auto it = faceIndices.find(backendType);
+  if (it != faceIndices.end()) {
+    return it->second;
+  }
+
+  FaceIndex& index = faceIndices[backendType];
+  PangoFontMap* fontMap = AcquireFontMap(backendType, lane);
+  if (fontMap == nullptr) {
+    return index;
+  }
+
+  PangoFontFamily** families;
+  int n_families;
+  pango_font_map_list_families(fontMap, &families, &n_families);
+  for (int i = 0; i < n_families; i++) {
+    const char* family_name = pango_font_family_get_name(families[i]);
+    PangoFontFace** faces;
+    int n_faces;
+    pango_font_family_list_faces(families[i], &faces, &n_faces);
+    for (int j = 0; j < n_faces; j++) {
+      const char* face_name = pango_font_face_get_face_name(faces[j]);
+      std::string key = fontKey(family_name, face_name);
+      // Keep the first match, like the linear search did.
+      if (index.find(key) == index.end()) {
+        index[key] = pango_font_face_describe(faces[j]);
+      }
+    }
+    g_free(faces);
+  }
+  g_free(families);
+  g_object_unref(fontMap);
+  return index;
+}
+
+static PangoFontDescription* lookupLocked(const std::string& family,
+                                          const std::string& face,
+                                          _cairo_font_type backendType,
+                                          int lane) {
+  FaceIndex& index = getFaceIndexLocked(backendType, lane);
+  auto it = index.find(fontKey(family, face));
+  if (it == index.end()) {
+    return nullptr;
+  }
+  return it->second;
+}
+
+static void resolveLocked(RegisteredFont& font, int lane) {
+  if (font.resolved) {
+    return;
+  }
+  font.resolved = true;
+  PangoFontDescription* description =
+      lookupLocked(font.family, font.face, font.backendType, lane);
+  if (description == nullptr) {
+    printf("Could not find font (%s:%s), falling back to default font.\n",
+           font.family.c_str(), font.face.c_str());
+    return;
+  }
+  font.description = pango_font_description_copy(description);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT int RegisterFont(
+    const char* family,
+    const char* face,
+    _cairo_font_type backendType) {
+  std::string familyName = family != nullptr ? family : "";
+  std::string faceName = face != nullptr ? face : "";
+  std::string key = fontKey(familyName, faceName);
+  key += '\x1f';
+  key += std::to_string((int)backendType);
+
+  // Resolving may list the fonts on lane 0. The lane is always locked before
+  // the registry, like in CreateFontDescription.
+  std::lock_guard<std::mutex> laneLock(FontMapLaneMutex(0));
+  std::lock_guard<std::mutex> lock(registryMutex);
+  auto it = registeredFontIds.find(key);
+  if (it != registeredFontIds.end()) {
+    return it->second;
+  }
+
+  int fontId = (int)registeredFonts.size();
+  RegisteredFont font;
+  font.family = familyName;
+  font.face = faceName;
+  font.backendType = backendType;
+  // Empty names always use the default font.
+  font.resolved = familyName.empty() || faceName.empty();
+  registeredFonts.push_back(font);
+  registeredFontIds[key] = fontId;
+  resolveLocked(registeredFonts.back(), 0);
+  return fontId;
+}
+
+PangoFontDescription* CreateFontDescription(int fontId, int lane) {
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    if (fontId >= 0 && fontId < (int)registeredFonts.size()) {
+      RegisteredFont& font = registeredFonts[fontId];
+      resolveLocked(font, lane);
+      if (font.description != nullptr) {
+        return pango_font_description_copy(font.description);
+      }
+    }
+  }
+  PangoFontDescription* description = pango_font_description_from_string("Sans");
+  if (description == nullptr) {
+    printf("Could not find default font (Sans)");
+  }
+  return description;
+}
+
+_cairo_font_type GetRegisteredFontBackend(int fontId) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  if (fontId >= 0 && fontId < (int)registeredFonts.size()) {
+    return registeredFonts[fontId].backendType;
+  }
+  return CAIRO_FONT_TYPE_FT;
+}
+
+PangoFontDescription* LookupFontDescription(const char* family,
+                                            const char* face,
+                                            _cairo_font_type backendType) {
+  if (family == nullptr || face == nullptr) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> laneLock(FontMapLaneMutex(0));
+  std::lock_guard<std::mutex> lock(registryMutex);
+  PangoFontDescription* description =
+      lookupLocked(family, face, backendType, 0);
+  if (description == nullptr) {
+    return nullptr;
+  }
+  return pango_font_description_copy(description);
+}
+
+void ResetFontRegistry() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for (auto& entry : faceIndices) {
+    for (auto& face : entry.second) {
+      pango_font_description_free(face.second);
+    }
+  }
+  faceIndices.clear();
+  for (auto& font : registeredFonts) {
+    if (font.description != nullptr) {
+      pango_font_description_free(font.description);
+      font.description = nullptr;
+    }
+    font.resolved = font.family.empty() || font.face.empty();
+  }
+}
+
+}  // namespace HQText
@@ -0,0 +1,40 @@
+#ifndef HQTEXT_FONTREGISTRY_H
+#define HQTEXT_FONTREGISTRY_H
+
+#include <cairo.h>
+#include <pango/pango.h>
+#include <pango/pangocairo.h>
+#include "Unity/IUnityInterface.h"
+
+namespace HQText {
+
+// RegisterFont returns a stable id for a family/face/backend combination that
+// can be passed to SetTextDataWithFontId and GetTextSizeWithFontId. Registering
+// the same font again returns the same id. Unknown fonts still get an id and
+// render with the default font.
+extern "C" UNITY_INTERFACE_EXPORT int RegisterFont(const char* family,
+                                                   const char* face,
+                                                   _cairo_font_type backendType);
+
+// CreateFontDescription returns a new description for a registered font,
+// falling back to "Sans" for unknown ids or fonts that could not be found.
+// Free it with pango_font_description_free. Call it with
+// FontMapLaneMutex(lane) held, as resolving the font may list the fonts of
+// the lane's font map.
+PangoFontDescription* CreateFontDescription(int fontId, int lane = 0);
+
+// GetRegisteredFontBackend returns the backend a font was registered with.
+_cairo_font_type GetRegisteredFontBackend(int fontId);
+
+// LookupFontDescription returns a copy of the description for the given
+// family and face from the backend's font index, or nullptr if not found.
+PangoFontDescription* LookupFontDescription(const char* family,
+                                            const char* face,
+                                            _cairo_font_type backendType);
+
+// ResetFontRegistry drops the cached font index and descriptions so they are
+// rebuilt from the current font config. Font ids stay valid.
+void ResetFontRegistry();
+
+}  // namespace HQText
+#endif  // HQTEXT_FONTREGISTRY_H
@@ -0,0 +1,246 @@
+#include "GlyphAtlas.h"
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace HQText {
+
+static const int atlasMaxPages = 8;
+// Empty texels around each glyph, so bilinear filtering doesn't pick up the
+// neighbours.
+static const int glyphPadding = 1;
+// The page of a cached glyph that didn't fit in the atlas. It isn't
+// rasterized again until the atlas is reset.
+static const int droppedGlyphPage = -1;
+
+struct AtlasShelf {
+  int y;
+  int height;
+  int cursorX;
+};
+
+struct AtlasPage {
+  std::vector<unsigned char> pixels;
+  std::vector<AtlasShelf> shelves;
+  int nextShelfY = 0;
+  unsigned int version = 0;
+
+  AtlasPage() : pixels((size_t)GlyphAtlasPageSize * GlyphAtlasPageSize, 0) {}
+};
+
+struct GlyphCacheKey {
+  int fontKey;
+  PangoGlyph glyph;
+  int subpixel;
+
+  bool operator==(const GlyphCacheKey& other) const {
+    return fontKey == other.fontKey && glyph == other.glyph &&
+           subpixel == other.subpixel;
+  }
+};
+
+struct GlyphCacheKeyHash {
+  size_t operator()(const GlyphCacheKey& key) const {
+    size_t h = (size_t)key.glyph * 0x9E3779B97F4A7C15ull;
+    h ^= (size_t)key.fontKey * 0xC2B2AE3D27D4EB4Full + (h >> 29);
+    return h ^ (size_t)key.subpixel;
+  }
+};
+
+static std::vector<std::unique_ptr<AtlasPage>> pages = {};
+static std::unordered_map<GlyphCacheKey, GlyphAtlasEntry, GlyphCacheKeyHash>
+    glyphs = {};
+// Kept across resets, so keys handed out before a reset stay valid.
+static std::map<std::string, int> fontKeys = {};
+static unsigned int epoch = 1;
+// Page versions are never reused, even across resets.
+static unsigned int lastPageVersion = 0;
+static unsigned int droppedGlyphs = 0;
+static std::mutex atlasMutex;
+
+int GlyphFontKey(PangoFont* font) {
+  PangoFontDescription* desc = pango_font_describe_with_absolute_size(font);
+  char* name = pango_font_description_to_string(desc);
+  std::string key = name;
+  g_free(name);
+  pango_font_description_free(desc);
+
+  std::lock_guard<std::mutex> lock(atlasMutex);
+  auto it = fontKeys.find(key);
+  if (it != fontKeys.end()) {
+    return it->second;
+  }
+  int id = (int)fontKeys.size();
+  fontKeys[key] = id;
+  return id;
+}
+
+// allocateLocked finds room for a width x height bitmap on the first page
+// with a shelf that fits, opening a new shelf or page when needed.
+static bool allocateLocked(int width, int height, GlyphAtlasEntry* entry) {
+  if (width > GlyphAtlasPageSize || height > GlyphAtlasPageSize) {
+    return false;
+  }
+  for (size_t p = 0;; ++p) {
+    if (p == pages.size()) {
+      if (pages.size() >= (size_t)atlasMaxPages) {
+        return false;
+      }
+      pages.push_back(std::unique_ptr<AtlasPage>(new AtlasPage()));
+    }
+    AtlasPage& page = *pages[p];
+    // Prefer a shelf that isn't much taller than the glyph.
+    for (AtlasShelf& shelf : page.shelves) {
+      if (shelf.height >= height && shelf.height <= height + height / 4 + 2 &&
+          shelf.cursorX + width <= GlyphAtlasPageSize) {
+        entry->page = (int)p;
+        entry->x = shelf.cursorX;
+        entry->y = shelf.y;
+        shelf.cursorX += width;
+        return true;
+      }
+    }
+    if (page.nextShelfY + height <= GlyphAtlasPageSize) {
+      page.shelves.push_back({page.nextShelfY, height, width});
+      entry->page = (int)p;
+      entry->x = 0;
+      entry->y = page.nextShelfY;
+      page.nextShelfY += height;
+      return true;
+    }
+  }
+}
+
+// rasterizeGlyph draws the glyph into an A8 bitmap with its origin at the
+// given subpixel step.
+static std::vector<unsigned char> rasterizeGlyph(PangoFont* font,
+                                                 PangoGlyph glyph,
+                                                 int subpixel,
+                                                 const GlyphAtlasEntry& entry) {
+  cairo_surface_t* surface =
+      cairo_image_surface_create(CAIRO_FORMAT_A8, entry.width, entry.height);
+  cairo_t* cr = cairo_create(surface);
+  cairo_set_source_rgba(cr, 0, 0, 0, 1);
+  cairo_move_to(cr, -entry.bearingX + (double)subpixel / GlyphSubpixelSteps,
+                -entry.bearingY);
+
+  PangoGlyphString* glyphString = pango_glyph_string_new();
+  pango_glyph_string_set_size(glyphString, 1);
+  glyphString->glyphs[0].glyph = glyph;
+  glyphString->glyphs[0].geometry.width = 0;
+  glyphString->glyphs[0].geometry.x_offset = 0;
+  glyphString->glyphs[0].geometry.y_offset = 0;
+  glyphString->log_clusters[0] = 0;
+  pango_cairo_show_glyph_string(cr, font, glyphString);
+  pango_glyph_string_free(glyphString);
+  cairo_destroy(cr);
+  cairo_surface_flush(surface);
+
+  std::vector<unsigned char> bitmap((size_t)entry.width * entry.height);
+  const unsigned char* data = cairo_image_surface_get_data(surface);
+  int stride = cairo_image_surface_get_stride(surface);
+  for (int y = 0; y < entry.height; ++y) {
+    memcpy(&bitmap[(size_t)y * entry.width], data + (size_t)y * stride,
+           entry.width);
+  }
+  cairo_surface_destroy(surface);
+  return bitmap;
+}
+
+bool FindOrAddGlyph(PangoFont* font,
+                    int fontKey,
+                    PangoGlyph glyph,
+                    int subpixel,
+                    GlyphAtlasEntry* entry) {
+  GlyphCacheKey key = {fontKey, glyph, subpixel};
+  {
+    std::lock_guard<std::mutex> lock(atlasMutex);
+    auto it = glyphs.find(key);
+    if (it != glyphs.end()) {
+      *entry = it->second;
+      return entry->width > 0 && entry->page != droppedGlyphPage;
+    }
+  }
+
+  PangoRectangle ink;
+  pango_font_get_glyph_extents(font, glyph, &ink, nullptr);
+  GlyphAtlasEntry added = {};
+  if (ink.width > 0 && ink.height > 0) {
+    int left = (int)std::floor((double)ink.x / PANGO_SCALE);
+    int top = (int)std::floor((double)ink.y / PANGO_SCALE);
+    int right = (int)std::ceil((double)(ink.x + ink.width) / PANGO_SCALE);
+    int bottom = (int)std::ceil((double)(ink.y + ink.height) / PANGO_SCALE);
+    added.bearingX = left - glyphPadding;
+    added.bearingY = top - glyphPadding;
+    // One extra column for the subpixel shift.
+    added.width = right - left + 2 * glyphPadding + 1;
+    added.height = bottom - top + 2 * glyphPadding;
+  }
+  std::vector<unsigned char> bitmap;
+  if (added.width > 0) {
+    // Rasterize outside the atlas lock, so other lanes aren't held up. The
+    // caller holds the font's lane mutex.
+    bitmap = rasterizeGlyph(font, glyph, subpixel, added);
+  }
+
+  std::lock_guard<std::mutex> lock(atlasMutex);
+  auto it = glyphs.find(key);
+  if (it != glyphs.end()) {
+    // Another lane added it first.
+    *entry = it->second;
+    return entry->width > 0 && entry->page != droppedGlyphPage;
+  }
+  if (added.width > 0) {
+    if (!allocateLocked(added.width, added.height, &added)) {
+      droppedGlyphs++;
+      added.page = droppedGlyphPage;
+      glyphs[key] = added;
+      *entry = added;
+      return false;
+    }
+    AtlasPage& page = *pages[added.page];
+    for (int y = 0; y < added.height; ++y) {
+      memcpy(&page.pixels[(size_t)(added.y + y) * GlyphAtlasPageSize + added.x],
+             &bitmap[(size_t)y * added.width], added.width);
+    }
+    page.version = ++lastPageVersion;
+  }
+  glyphs[key] = added;
+  *entry = added;
+  return added.width > 0;
+}
+
+void GetGlyphAtlasInfo(GlyphAtlasInfo* info) {
+  std::lock_guard<std::mutex> lock(atlasMutex);
+  info->pageCount = (int)pages.size();
+  info->pageSize = GlyphAtlasPageSize;
+  info->epoch = epoch;
+  info->droppedGlyphs = droppedGlyphs;
+}
+
+unsigned int CopyGlyphAtlasPage(int page, unsigned char* dst, int dstSize) {
+  std::lock_guard<std::mutex> lock(atlasMutex);
+  if (page < 0 || page >= (int)pages.size()) {
+    return 0;
+  }
+  const AtlasPage& atlasPage = *pages[page];
+  if (dst != nullptr && (size_t)dstSize >= atlasPage.pixels.size()) {
+    memcpy(dst, atlasPage.pixels.data(), atlasPage.pixels.size());
+  }
+  return atlasPage.version;
+}
+
+void ResetGlyphAtlas() {
+  std::lock_guard<std::mutex> lock(atlasMutex);
+  pages.clear();
+  glyphs.clear();
+  droppedGlyphs = 0;
+  epoch++;
+}
+
+}  // namespace HQText
@@ -0,0 +1,72 @@
+#ifndef HQTEXT_GLYPHATLAS_H
+#define HQTEXT_GLYPHATLAS_H
+
+#include <pango/pango.h>
+#include <pango/pangocairo.h>
+#include "Unity/IUnityInterface.h"
+
+namespace HQText {
+
+struct GlyphAtlasInfo {
+  int pageCount;
+  // Pages are square, one byte of coverage per texel.
+  int pageSize;
+  // Changes when ResetGlyphAtlas drops every glyph. Quads from an older epoch
+  // reference glyphs that are gone.
+  unsigned int epoch;
+  // Glyphs of this epoch left out of quads because every page was full, each
+  // counted once.
+  unsigned int droppedGlyphs;
+};
+
+// GlyphAtlasEntry is where a glyph's coverage bitmap lives in the atlas. The
+// bitmap's top left corner is at (bearingX, bearingY) pixels from the glyph
+// origin on the baseline.
+struct GlyphAtlasEntry {
+  int page;
+  int x;
+  int y;
+  int width;
+  int height;
+  int bearingX;
+  int bearingY;
+};
+
+// The width and height of every atlas page.
+const int GlyphAtlasPageSize = 1024;
+// The number of horizontal subpixel positions each glyph is rasterized at.
+const int GlyphSubpixelSteps = 4;
+
+// FindOrAddGlyph returns the atlas entry for glyph drawn from font at the
+// given subpixel step, rasterizing it into the atlas on first use. fontKey
+// identifies the font across font map lanes (see GlyphFontKey). Returns false
+// if the glyph has no ink or the atlas is full. font must only be used with
+// its lane's mutex held, which the caller must hold.
+bool FindOrAddGlyph(PangoFont* font,
+                    int fontKey,
+                    PangoGlyph glyph,
+                    int subpixel,
+                    GlyphAtlasEntry* entry);
+
+// GlyphFontKey returns a small id for the font's description and size, which
+// is the same for equal fonts from different font maps.
+int GlyphFontKey(PangoFont* font);
+
+extern "C" UNITY_INTERFACE_EXPORT void GetGlyphAtlasInfo(GlyphAtlasInfo* info);
+
+// CopyGlyphAtlasPage returns the page's version, which changes whenever glyphs
+// are added to it, and copies its pageSize * pageSize coverage bytes to dst
+// unless dst is null or dstSize is too small. Row 0 is the top of the glyphs,
+// and the quads' texture coordinates expect the bytes to be uploaded as they
+// are. Returns 0 for an unknown page.
+extern "C" UNITY_INTERFACE_EXPORT unsigned int CopyGlyphAtlasPage(
+    int page,
+    unsigned char* dst,
+    int dstSize);
+
+// ResetGlyphAtlas drops every glyph, e.g. when the atlas is full, and starts a
+// new epoch.
+extern "C" UNITY_INTERFACE_EXPORT void ResetGlyphAtlas();
+
+}  // namespace HQText
+#endif  // HQTEXT_GLYPHATLAS_H
@@ -0,0 +1,25 @@
+#ifndef HQTEXT_GLYPHQUAD_H
+#define HQTEXT_GLYPHQUAD_H
+namespace HQText {
+// GlyphQuad places one glyph bitmap from the glyph atlas in a label. The
+// position is in pixels from the label's top left corner, y down, and the
+// texture coordinates are those of the quad's top left and bottom right
+// corners on the atlas page. The colour has straight alpha and multiplies the
+// atlas coverage.
+struct GlyphQuad {
+  float x;
+  float y;
+  float width;
+  float height;
+  float u0;
+  float v0;
+  float u1;
+  float v1;
+  float r;
+  float g;
+  float b;
+  float a;
+  int page;
+};
+}  // namespace HQText
+#endif  // HQTEXT_GLYPHQUAD_H
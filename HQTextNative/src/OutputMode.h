@@ -0,0 +1,16 @@
+#ifndef HQTEXT_OUTPUTMODE_H
+#define HQTEXT_OUTPUTMODE_H
+namespace HQText {
+// OutputMode selects how a label is meant to be drawn. Texture labels are
+// rasterized into their own texture, glyph quad labels are drawn from the
+// shared glyph atlas with GetGlyphQuads and are never pre-rasterized.
+// Distance field labels get a texture holding the signed distance to the
+// glyph edges, which a shader can threshold at any scale.
+enum OutputMode {
+  OutputTexture = 0,
+  OutputGlyphQuads = 1,
+  OutputDistanceField = 2,
+  OutputModeSentinel = 3
+};
+}
+#endif  // HQTEXT_OUTPUTMODE_H
@@ -0,0 +1,394 @@
+#include "PixelConversion.h"
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#ifdef HQTEXT_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define HQTEXT_TARGET_AVX2
+#else
+#define HQTEXT_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace HQText {
+
+// reciprocalTable holds ceil(255 * 2^16 / a), so that
+// (c * reciprocalTable[a] + 2^15) >> 16 is c * 255 / a rounded to nearest for
+// every c <= a, without a division per channel.
+struct ReciprocalTable {
+  uint32_t values[256];
+
+  ReciprocalTable() {
+    values[0] = 0;
+    for (uint32_t a = 1; a < 256; ++a) {
+      values[a] = ((255u << 16) + a - 1) / a;
+    }
+  }
+};
+static const ReciprocalTable reciprocalTable;
+
+static inline uint32_t unpremultiplyChannel(uint32_t c, uint32_t reciprocal) {
+  uint32_t v = (c * reciprocal + 0x8000) >> 16;
+  return v > 255 ? 255 : v;
+}
+
+// Cairo stores ARGB32 as native endian words, which on little endian is
+// B, G, R, A in memory. Unity's RGBA32 wants R, G, B, A, so red and blue swap
+// places, while BGRA32 keeps cairo's order.
+template <bool swapRedBlue>
+static void unpremultiplyRowScalar(const uint32_t* src,
+                                   uint32_t* dst,
+                                   int width) {
+  for (int x = 0; x < width; ++x) {
+    uint32_t p = src[x];
+    uint32_t a = p >> 24;
+    uint32_t reciprocal = reciprocalTable.values[a];
+    uint32_t r = unpremultiplyChannel((p >> 16) & 0xFF, reciprocal);
+    uint32_t g = unpremultiplyChannel((p >> 8) & 0xFF, reciprocal);
+    uint32_t b = unpremultiplyChannel(p & 0xFF, reciprocal);
+    dst[x] = swapRedBlue ? (a << 24 | b << 16 | g << 8 | r)
+                         : (a << 24 | r << 16 | g << 8 | b);
+  }
+}
+
+void UnpremultiplyRowScalar(const uint32_t* src,
+                            uint32_t* dst,
+                            int width,
+                            bool swapRedBlue) {
+  if (swapRedBlue) {
+    unpremultiplyRowScalar<true>(src, dst, width);
+  } else {
+    unpremultiplyRowScalar<false>(src, dst, width);
+  }
+}
+
+static void copyRow(const uint32_t* src, uint32_t* dst, int width) {
+  if (src != dst) {
+    memcpy(dst, src, (size_t)width * sizeof(uint32_t));
+  }
+}
+
+static void swizzleRowScalar(const uint32_t* src, uint32_t* dst, int width) {
+  for (int x = 0; x < width; ++x) {
+    uint32_t p = src[x];
+    dst[x] = (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+  }
+}
+
+#ifdef HQTEXT_X86
+
+static void swizzleRowSSE2(const uint32_t* src, uint32_t* dst, int width) {
+  const __m128i keep = _mm_set1_epi32((int)0xFF00FF00);
+  const __m128i low = _mm_set1_epi32(0xFF);
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+    __m128i out = _mm_or_si128(
+        _mm_and_si128(p, keep),
+        _mm_or_si128(_mm_and_si128(_mm_srli_epi32(p, 16), low),
+                     _mm_slli_epi32(_mm_and_si128(p, low), 16)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), out);
+  }
+  swizzleRowScalar(src + x, dst + x, width - x);
+}
+
+// SSE2 has no 32 bit low multiply, so build it from two 32x32->64 multiplies.
+static inline __m128i mullo32SSE2(__m128i a, __m128i b) {
+  __m128i even = _mm_mul_epu32(a, b);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128i unpremultiplyChannelSSE2(__m128i c, __m128i reciprocal) {
+  const __m128i half = _mm_set1_epi32(0x8000);
+  const __m128i max = _mm_set1_epi32(255);
+  __m128i v = _mm_srli_epi32(_mm_add_epi32(mullo32SSE2(c, reciprocal), half), 16);
+  __m128i over = _mm_cmpgt_epi32(v, max);
+  return _mm_or_si128(_mm_andnot_si128(over, v), _mm_and_si128(over, max));
+}
+
+template <bool swapRedBlue>
+static void unpremultiplyRowSSE2(const uint32_t* src,
+                                 uint32_t* dst,
+                                 int width) {
+  const __m128i mask = _mm_set1_epi32(0xFF);
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+    __m128i reciprocal = _mm_set_epi32(
+        (int)reciprocalTable.values[src[x + 3] >> 24],
+        (int)reciprocalTable.values[src[x + 2] >> 24],
+        (int)reciprocalTable.values[src[x + 1] >> 24],
+        (int)reciprocalTable.values[src[x] >> 24]);
+    __m128i r = unpremultiplyChannelSSE2(
+        _mm_and_si128(_mm_srli_epi32(p, 16), mask), reciprocal);
+    __m128i g = unpremultiplyChannelSSE2(
+        _mm_and_si128(_mm_srli_epi32(p, 8), mask), reciprocal);
+    __m128i b = unpremultiplyChannelSSE2(_mm_and_si128(p, mask), reciprocal);
+    __m128i a = _mm_slli_epi32(_mm_srli_epi32(p, 24), 24);
+    if (!swapRedBlue) {
+      std::swap(r, b);
+    }
+    __m128i out = _mm_or_si128(
+        _mm_or_si128(a, _mm_slli_epi32(b, 16)),
+        _mm_or_si128(_mm_slli_epi32(g, 8), r));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), out);
+  }
+  unpremultiplyRowScalar<swapRedBlue>(src + x, dst + x, width - x);
+}
+
+HQTEXT_TARGET_AVX2 static inline __m256i unpremultiplyChannelAVX2(
+    __m256i c,
+    __m256i reciprocal) {
+  const __m256i half = _mm256_set1_epi32(0x8000);
+  const __m256i max = _mm256_set1_epi32(255);
+  __m256i v = _mm256_srli_epi32(
+      _mm256_add_epi32(_mm256_mullo_epi32(c, reciprocal), half), 16);
+  return _mm256_min_epu32(v, max);
+}
+
+template <bool swapRedBlue>
+HQTEXT_TARGET_AVX2 static void unpremultiplyRowAVX2(const uint32_t* src,
+                                                    uint32_t* dst,
+                                                    int width) {
+  const __m256i mask = _mm256_set1_epi32(0xFF);
+  const int* table = reinterpret_cast<const int*>(reciprocalTable.values);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x));
+    __m256i alpha = _mm256_srli_epi32(p, 24);
+    __m256i reciprocal = _mm256_i32gather_epi32(table, alpha, 4);
+    __m256i r = unpremultiplyChannelAVX2(
+        _mm256_and_si256(_mm256_srli_epi32(p, 16), mask), reciprocal);
+    __m256i g = unpremultiplyChannelAVX2(
+        _mm256_and_si256(_mm256_srli_epi32(p, 8), mask), reciprocal);
+    __m256i b =
+        unpremultiplyChannelAVX2(_mm256_and_si256(p, mask), reciprocal);
+    if (!swapRedBlue) {
+      std::swap(r, b);
+    }
+    __m256i out = _mm256_or_si256(
+        _mm256_or_si256(_mm256_slli_epi32(alpha, 24), _mm256_slli_epi32(b, 16)),
+        _mm256_or_si256(_mm256_slli_epi32(g, 8), r));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), out);
+  }
+  unpremultiplyRowScalar<swapRedBlue>(src + x, dst + x, width - x);
+}
+
+static bool cpuSupportsAVX2() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx) {
+    return false;
+  }
+  // The OS has to save the YMM registers on context switches.
+  if ((_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+void UnpremultiplyRowSSE2(const uint32_t* src,
+                          uint32_t* dst,
+                          int width,
+                          bool swapRedBlue) {
+  if (swapRedBlue) {
+    unpremultiplyRowSSE2<true>(src, dst, width);
+  } else {
+    unpremultiplyRowSSE2<false>(src, dst, width);
+  }
+}
+
+void UnpremultiplyRowAVX2(const uint32_t* src,
+                          uint32_t* dst,
+                          int width,
+                          bool swapRedBlue) {
+  if (swapRedBlue) {
+    unpremultiplyRowAVX2<true>(src, dst, width);
+  } else {
+    unpremultiplyRowAVX2<false>(src, dst, width);
+  }
+}
+
+bool CpuSupportsAVX2() {
+  static const bool supported = cpuSupportsAVX2();
+  return supported;
+}
+
+#endif  // HQTEXT_X86
+
+typedef void (*RowFunc)(const uint32_t*, uint32_t*, int);
+
+template <bool swapRedBlue>
+static RowFunc selectUnpremultiplyRow() {
+#ifdef HQTEXT_X86
+  if (CpuSupportsAVX2()) {
+    return unpremultiplyRowAVX2<swapRedBlue>;
+  }
+  // SSE2 is part of the x86-64 baseline.
+  return unpremultiplyRowSSE2<swapRedBlue>;
+#else
+  return unpremultiplyRowScalar<swapRedBlue>;
+#endif
+}
+
+// convertFlip runs a row kernel over the image, writing each row to its
+// mirrored position. dstStride counts pixels. When converting in place,
+// mirrored row pairs go through a row sized scratch buffer so no full size
+// buffer is needed.
+static void convertFlip(RowFunc convertRow,
+                        const unsigned char* src,
+                        int srcStride,
+                        uint32_t* dst,
+                        int dstStride,
+                        int width,
+                        int height) {
+  if (static_cast<const void*>(src) != static_cast<const void*>(dst)) {
+    for (int y = 0; y < height; ++y) {
+      const uint32_t* srcRow =
+          reinterpret_cast<const uint32_t*>(src + (size_t)y * srcStride);
+      uint32_t* dstRow = dst + (size_t)(height - y - 1) * dstStride;
+      convertRow(srcRow, dstRow, width);
+    }
+    return;
+  }
+
+  static thread_local std::vector<uint32_t> scratch;
+  scratch.resize(width);
+  for (int y = 0; y < height / 2; ++y) {
+    uint32_t* top = dst + (size_t)y * dstStride;
+    uint32_t* bottom = dst + (size_t)(height - y - 1) * dstStride;
+    convertRow(top, scratch.data(), width);
+    convertRow(bottom, top, width);
+    memcpy(bottom, scratch.data(), (size_t)width * sizeof(uint32_t));
+  }
+  if (height % 2 != 0) {
+    uint32_t* middle = dst + (size_t)(height / 2) * dstStride;
+    convertRow(middle, middle, width);
+  }
+}
+
+static RowFunc swizzleRow() {
+#ifdef HQTEXT_X86
+  // The swizzle is bound by memory bandwidth, so there is no AVX2 variant.
+  return swizzleRowSSE2;
+#else
+  return swizzleRowScalar;
+#endif
+}
+
+// HalfTable holds the half float of every 8 bit channel value / 255, and the
+// float reciprocal of every alpha for un-premultiplying.
+struct HalfTable {
+  uint16_t values[256];
+  float reciprocals[256];
+
+  HalfTable() {
+    for (int i = 0; i < 256; ++i) {
+      values[i] = FloatToHalf(i / 255.0f);
+      reciprocals[i] = i == 0 ? 0.0f : 1.0f / i;
+    }
+  }
+};
+static const HalfTable halfTable;
+
+uint16_t FloatToHalf(float value) {
+  // Smaller than the smallest normal half, so it becomes a subnormal.
+  if (value < 6.103515625e-05f) {
+    return (uint16_t)(value * 16777216.0f + 0.5f);
+  }
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  // Round the mantissa to nearest even, letting a carry bump the exponent,
+  // then rebias the exponent from 127 to 15.
+  uint32_t rounded = bits + 0xFFF + ((bits >> 13) & 1);
+  return (uint16_t)((rounded >> 13) - ((127 - 15) << 10));
+}
+
+static void halfRowPremultiplied(const uint32_t* src, Color16* dst, int width) {
+  for (int x = 0; x < width; ++x) {
+    uint32_t p = src[x];
+    dst[x].r = halfTable.values[(p >> 16) & 0xFF];
+    dst[x].g = halfTable.values[(p >> 8) & 0xFF];
+    dst[x].b = halfTable.values[p & 0xFF];
+    dst[x].a = halfTable.values[p >> 24];
+  }
+}
+
+// halfRowStraight divides by alpha in float, so the straight colours keep
+// more precision than the 8 bit formats.
+static void halfRowStraight(const uint32_t* src, Color16* dst, int width) {
+  for (int x = 0; x < width; ++x) {
+    uint32_t p = src[x];
+    uint32_t a = p >> 24;
+    float reciprocal = halfTable.reciprocals[a];
+    dst[x].r = FloatToHalf(((p >> 16) & 0xFF) * reciprocal);
+    dst[x].g = FloatToHalf(((p >> 8) & 0xFF) * reciprocal);
+    dst[x].b = FloatToHalf((p & 0xFF) * reciprocal);
+    dst[x].a = halfTable.values[a];
+  }
+}
+
+void ConvertFlip(const unsigned char* src,
+                 int srcStride,
+                 unsigned char* dst,
+                 int dstStride,
+                 int width,
+                 int height,
+                 RasterFormat format,
+                 bool premultiplied) {
+  static const RowFunc unpremultiplyRGBA = selectUnpremultiplyRow<true>();
+  static const RowFunc unpremultiplyBGRA = selectUnpremultiplyRow<false>();
+  auto dst32 = reinterpret_cast<uint32_t*>(dst);
+  int dstPixels = dstStride / 4;
+  switch (format) {
+    case RasterRGBA32:
+      convertFlip(premultiplied ? swizzleRow() : unpremultiplyRGBA, src,
+                  srcStride, dst32, dstPixels, width, height);
+      break;
+    case RasterBGRA32:
+      // Premultiplied BGRA is cairo's own layout, so only the flip is left.
+      convertFlip(premultiplied ? copyRow : unpremultiplyBGRA, src, srcStride,
+                  dst32, dstPixels, width, height);
+      break;
+    case RasterAlpha8:
+      // Coverage needs no conversion.
+      for (int y = 0; y < height; ++y) {
+        memcpy(dst + (size_t)(height - y - 1) * dstStride,
+               src + (size_t)y * srcStride, width);
+      }
+      break;
+    case RasterRGBAHalf:
+      for (int y = 0; y < height; ++y) {
+        auto srcRow =
+            reinterpret_cast<const uint32_t*>(src + (size_t)y * srcStride);
+        auto dstRow = reinterpret_cast<Color16*>(
+            dst + (size_t)(height - y - 1) * dstStride);
+        if (premultiplied) {
+          halfRowPremultiplied(srcRow, dstRow, width);
+        } else {
+          halfRowStraight(srcRow, dstRow, width);
+        }
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+}  // namespace HQText
@@ -0,0 +1,52 @@
+#ifndef HQTEXT_PIXELCONVERSION_H
+#define HQTEXT_PIXELCONVERSION_H
+
+#include <cstdint>
+#include "Color16.h"
+#include "RasterFormat.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define HQTEXT_X86 1
+#endif
+
+namespace HQText {
+
+// ConvertFlip converts a premultiplied cairo image into Unity texture rows of
+// the given format, flipping it vertically. src is ARGB32, or A8 for Alpha8.
+// dst rows are dstStride bytes apart. Colours stay premultiplied if
+// premultiplied is set, otherwise the 8 bit channels become c * 255 / a
+// rounded to nearest, using SSE2 or AVX2 when the cpu has them. The 4 byte
+// formats can convert in place, with src == dst and srcStride == dstStride.
+void ConvertFlip(const unsigned char* src,
+                 int srcStride,
+                 unsigned char* dst,
+                 int dstStride,
+                 int width,
+                 int height,
+                 RasterFormat format,
+                 bool premultiplied);
+
+// FloatToHalf rounds a colour channel in [0, 65504] to a half float.
+uint16_t FloatToHalf(float value);
+
+// The un-premultiply row kernels behind ConvertFlip. They are exposed so the
+// conversion test can check the SIMD kernels against the scalar one, which
+// is the reference. swapRedBlue gives RGBA32 output rather than BGRA32.
+void UnpremultiplyRowScalar(const uint32_t* src,
+                            uint32_t* dst,
+                            int width,
+                            bool swapRedBlue);
+#ifdef HQTEXT_X86
+void UnpremultiplyRowSSE2(const uint32_t* src,
+                          uint32_t* dst,
+                          int width,
+                          bool swapRedBlue);
+void UnpremultiplyRowAVX2(const uint32_t* src,
+                          uint32_t* dst,
+                          int width,
+                          bool swapRedBlue);
+bool CpuSupportsAVX2();
+#endif
+
+}  // namespace HQText
+#endif  // HQTEXT_PIXELCONVERSION_H
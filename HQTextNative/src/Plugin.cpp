@@ -1,11 +1,29 @@
 #include <fontconfig/fontconfig.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <iterator>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <vector>
+#include "ClusterGeometry.h"
+#include "DistanceField.h"
+#include "FontMapPool.h"
+#include "FontRegistry.h"
+#include "PixelConversion.h"
+#include "RasterDamage.h"
 #include "RenderData.h"
 #include "Renderer.h"
+#include "SlotMap.h"
 #include "TextInfo.h"
+#include "TextDataDescriptor.h"
 #include "TextSize.h"
+#include "TextSizeCache.h"
+#include "TextureBufferPool.h"
+#include "ThreadPool.h"
 #include "Unity/IUnityRenderingExtensions.h"
 
 #ifdef ISDLL
@@ -18,10 +36,52 @@
 typedef unsigned char u8;
 namespace HQText {
 
-static std::map<unsigned int, RenderData*> renderDataLUT = {};
-static unsigned int initCounter = 7690;
+// A published RenderData is never modified, except for its raster cache which
+// only the render thread touches. Updates build a modified copy and swap it in,
+// so m is only held for lookups and publishing. The handles returned by
+// Initialize index into the slot map, and the slot stays empty until the first
+// SetTextData.
+static SlotMap<std::shared_ptr<RenderData>> renderDataLUT;
+// Replaced and torn down instances, freed once nothing else references them.
+static std::vector<std::shared_ptr<RenderData>> retiredRenderData = {};
 static FcConfig* currentFontConfig = NULL;
+// Raster buffers handed to Unity, kept alive until the texture update ends.
+static std::map<void*, std::shared_ptr<TextureBuffer>> texturesInFlight = {};
+// Guards the tables in this file. It is only held briefly, and never while
+// waiting for a font map lane.
 std::mutex m;
+// Orders updates of the same instance that race to publish.
+static std::atomic<unsigned long long> updateSequence{0};
+
+// LayoutTicket tracks a SetTextDataAsync call until PollLayout collects it.
+struct LayoutTicket {
+  bool done = false;
+  TextInfo info;
+};
+static std::map<unsigned int, LayoutTicket> layoutTickets = {};
+static unsigned int nextTicket = 0;
+// The number of queued async layouts per instance. Synchronous updates wait
+// for them so they apply on top of the async result.
+static std::map<unsigned int, int> pendingLayouts = {};
+static std::condition_variable layoutDone;
+// Rasterize every published instance on the layout workers.
+static std::atomic<bool> preRasterize{false};
+// Numbers the raster images, starting at 1 so 0 can mean none.
+static std::atomic<unsigned int> rasterVersion{0};
+
+// AtomicRasterStats mirrors RasterStats with counters that rasterizations on
+// different lanes can update together.
+struct AtomicRasterStats {
+  std::atomic<unsigned long long> rasterizedBytes{0};
+  std::atomic<unsigned long long> uploadedBytes{0};
+  std::atomic<unsigned long long> fullRasterizations{0};
+  std::atomic<unsigned long long> partialRasterizations{0};
+  std::atomic<unsigned long long> unchangedRasterizations{0};
+};
+static AtomicRasterStats rasterStats;
+
+static void schedulePreRasterization(unsigned int index,
+                                     std::shared_ptr<RenderData> r);
 
 
 // NOTE: There was a CRASH when using Win32 for rendering - this was because of a bug in cairo where it wasn't calling InitializeCriticalSection, causing the DebugInfo field to be NULL which is not valid.
@@ -36,87 +96,423 @@ std::mutex m;
 //  also most people use dynamic linking which calls CAIRO_MUTEX_INITIALIZE(); in DllMain.
 
 
+// Initialize returns a handle for a new instance, or 0 if there are too many.
 extern "C" UNITY_INTERFACE_EXPORT unsigned int Initialize() {
-  initCounter++;
-  int index = initCounter;
-  return index;
+  std::lock_guard<std::mutex> lock(m);
+  return renderDataLUT.Insert(nullptr);
+}
+
+static std::shared_ptr<RenderData> findRenderData(unsigned int index) {
+  std::lock_guard<std::mutex> lock(m);
+  std::shared_ptr<RenderData>* slot = renderDataLUT.Find(index);
+  if (slot != nullptr)
+    return *slot;
+  return nullptr;
+}
+
+// publishRenderData swaps r in for index. It returns false if index isn't a
+// live handle, or if a newer update has already been published. The previous
+// instance is retired rather than freed, as the render thread may still be
+// drawing it.
+static bool publishRenderData(unsigned int index,
+                              std::shared_ptr<RenderData> r) {
+  std::lock_guard<std::mutex> lock(m);
+  std::shared_ptr<RenderData>* slot = renderDataLUT.Find(index);
+  if (slot == nullptr || (*slot && (*slot)->sequence > r->sequence)) {
+    return false;
+  }
+  if (*slot) {
+    retiredRenderData.push_back(std::move(*slot));
+  }
+  *slot = std::move(r);
+  return true;
+}
+
+// reclaimRetired frees the retired instances that are no longer referenced.
+// Retired instances can't be looked up any more, so once the list holds the
+// only reference nothing can take a new one. Freeing releases pango objects,
+// so each is freed under its lane's mutex, and the caller must not hold one.
+static void reclaimRetired() {
+  std::vector<std::shared_ptr<RenderData>> unreferenced;
+  {
+    std::lock_guard<std::mutex> lock(m);
+    auto referenced = std::partition(
+        retiredRenderData.begin(), retiredRenderData.end(),
+        [](const std::shared_ptr<RenderData>& r) {
+          return r.use_count() > 1;
+        });
+    std::move(referenced, retiredRenderData.end(),
+              std::back_inserter(unreferenced));
+    retiredRenderData.erase(referenced, retiredRenderData.end());
+  }
+  for (auto& r : unreferenced) {
+    std::lock_guard<std::mutex> laneLock(FontMapLaneMutex(r->lane));
+    r.reset();
+  }
+}
+
+// lockCurrentLane locks the font map lane of index's current instance, or
+// lane 0 if there is none yet, and returns the instance.
+static std::shared_ptr<RenderData> lockCurrentLane(
+    unsigned int index,
+    std::unique_lock<std::mutex>& laneLock) {
+  for (;;) {
+    std::shared_ptr<RenderData> current = findRenderData(index);
+    laneLock = std::unique_lock<std::mutex>(
+        FontMapLaneMutex(current ? current->lane : 0));
+    // Start again if an async layout moved it to another lane meanwhile.
+    if (findRenderData(index) == current) {
+      return current;
+    }
+    laneLock.unlock();
+  }
+}
+
+// waitForPendingLayouts blocks until the async layouts queued for index have
+// been published.
+static void waitForPendingLayouts(unsigned int index) {
+  std::unique_lock<std::mutex> lock(m);
+  layoutDone.wait(lock, [index] {
+    return pendingLayouts.find(index) == pendingLayouts.end();
+  });
 }
 
 extern "C" UNITY_INTERFACE_EXPORT void Teardown(unsigned int index) {
-  auto it = renderDataLUT.find(index);
-  if (it != renderDataLUT.end()) {
-    RenderData* data = it->second;
-    delete data;
-    renderDataLUT.erase(it);
+  {
+    std::lock_guard<std::mutex> lock(m);
+    std::shared_ptr<RenderData>* slot = renderDataLUT.Find(index);
+    if (slot == nullptr) {
+      return;
+    }
+    if (*slot) {
+      retiredRenderData.push_back(std::move(*slot));
+    }
+    renderDataLUT.Erase(index);
   }
+  reclaimRetired();
 }
 
+// GetRenderData returns the current instance for index. The pointer is only
+// valid until the next update or teardown of that index.
 extern "C" UNITY_INTERFACE_EXPORT RenderData* GetRenderData(
     unsigned int index) {
-  auto it = renderDataLUT.find(index);
-  if (it != renderDataLUT.end())
-    return it->second;
-  return NULL;
+  return findRenderData(index).get();
 }
 
-extern "C" UNITY_INTERFACE_EXPORT TextSize GetTextSize(char* data,
-                                                       char* fontname,
-                                                       char* fontface,
-                                                       int fontSize,
-                                                       float lineSpacing,
-                                                       _cairo_font_type ft,
-                                                       gboolean useMarkup) {
-  PangoFontDescription* desc;
-  PangoFontMap* fontMap = pango_cairo_font_map_new_for_font_type(ft);
-  PangoContext* pangoContext = pango_font_map_create_context(fontMap);
+// createMeasureLayout returns an unwrapped layout on the given lane, set up
+// with the font that measureText measures in. The lane's mutex must be held
+// while using it and when unreffing it.
+static PangoLayout* createMeasureLayout(_cairo_font_type ft,
+                                        int fontId,
+                                        int fontSize,
+                                        float lineSpacing,
+                                        int lane) {
+  PangoContext* pangoContext = AcquireContext(ft, PANGO_DIRECTION_WEAK_LTR,
+                                              CAIRO_ANTIALIAS_DEFAULT, lane);
   PangoLayout* pangoLayout = pango_layout_new(pangoContext);
+  g_object_unref(pangoContext);
 
   // no wrapping
   pango_layout_set_width(pangoLayout, -1);
-  desc = GetFontDescriptionFromString(fontname, fontface, ft);
-  if (desc == nullptr) {
-    desc = pango_font_description_from_string("Sans");
-  }
-  if (fontSize <= 0) {
-    fontSize = 1;
-  }
-
+  PangoFontDescription* desc = CreateFontDescription(fontId, lane);
   pango_font_description_set_absolute_size(
       desc, fontSize * DEVICE_DPI * PANGO_SCALE / DEVICE_DPI);
   pango_layout_set_font_description(pangoLayout, desc);
+  pango_font_description_free(desc);
+  pango_layout_set_spacing(pangoLayout, lineSpacing);
+  return pangoLayout;
+}
+
+static TextSize measureText(PangoLayout* pangoLayout,
+                            const char* data,
+                            gboolean useMarkup) {
   if (useMarkup) {
     pango_layout_set_markup(pangoLayout, data, -1);
   } else {
     pango_layout_set_text(pangoLayout, data, -1);
   }
 
-  pango_layout_set_spacing(pangoLayout, lineSpacing);
-
   PangoRectangle inkRect;
   PangoRectangle logicalRect;
 
   pango_layout_get_extents(pangoLayout, &inkRect, &logicalRect);
-  TextSize t = TextSize(
+  return TextSize(
       logicalRect.width / PANGO_SCALE, logicalRect.height / PANGO_SCALE,
       inkRect.width / PANGO_SCALE, inkRect.height / PANGO_SCALE);
-  if (pangoContext != nullptr) {
-    g_object_unref(pangoContext);
-  } else {
-    printf("Pango context is null");
+}
+
+extern "C" UNITY_INTERFACE_EXPORT TextSize
+GetTextSizeWithFontId(char* data,
+                      int fontId,
+                      int fontSize,
+                      float lineSpacing,
+                      gboolean useMarkup) {
+  _cairo_font_type ft = GetRegisteredFontBackend(fontId);
+  if (fontSize <= 0) {
+    fontSize = 1;
+  }
+  // Layout code measures the same strings over and over, so the cache saves
+  // shaping them again.
+  TextSizeKey key =
+      MakeTextSizeKey(data, fontId, fontSize, lineSpacing, useMarkup, ft);
+  TextSize cached(0, 0, 0, 0);
+  if (FindTextSize(key, &cached)) {
+    return cached;
   }
-  if (pangoLayout != nullptr) {
+
+  std::lock_guard<std::mutex> laneLock(FontMapLaneMutex(0));
+  PangoLayout* pangoLayout =
+      createMeasureLayout(ft, fontId, fontSize, lineSpacing, 0);
+  TextSize t = measureText(pangoLayout, data, useMarkup);
+  g_object_unref(pangoLayout);
+  AddTextSize(key, t);
+  return t;
+}
+
+// Strings measured per job by GetTextSizes. Each job sets up its layout once.
+static const int measureChunkSize = 64;
+
+// GetTextSizes measures count strings in the same font and writes their sizes
+// to sizes, like calling GetTextSizeWithFontId for each. Strings that aren't
+// cached are measured on the layout workers, each of which reuses one layout
+// from its own font map lane for its share of the batch.
+extern "C" UNITY_INTERFACE_EXPORT void GetTextSizes(const char** strings,
+                                                    int count,
+                                                    int fontId,
+                                                    int fontSize,
+                                                    float lineSpacing,
+                                                    gboolean useMarkup,
+                                                    TextSize* sizes) {
+  if (strings == nullptr || sizes == nullptr || count <= 0) {
+    return;
+  }
+  _cairo_font_type ft = GetRegisteredFontBackend(fontId);
+  if (fontSize <= 0) {
+    fontSize = 1;
+  }
+
+  std::vector<TextSizeKey> keys;
+  std::vector<int> misses;
+  keys.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    keys.push_back(MakeTextSizeKey(strings[i], fontId, fontSize, lineSpacing,
+                                   useMarkup, ft));
+    if (!FindTextSize(keys[i], &sizes[i])) {
+      misses.push_back(i);
+    }
+  }
+
+  // measureChunk measures the misses in [begin, end) on the lane.
+  auto measureChunk = [&](size_t begin, size_t end, int lane) {
+    std::lock_guard<std::mutex> laneLock(FontMapLaneMutex(lane));
+    PangoLayout* pangoLayout =
+        createMeasureLayout(ft, fontId, fontSize, lineSpacing, lane);
+    for (size_t miss = begin; miss < end; ++miss) {
+      int i = misses[miss];
+      sizes[i] = measureText(pangoLayout, keys[i].text.c_str(), useMarkup);
+    }
     g_object_unref(pangoLayout);
+  };
+
+  if (misses.size() <= (size_t)measureChunkSize) {
+    // Not worth waking the workers for.
+    measureChunk(0, misses.size(), 0);
   } else {
-    printf("Pango layout is null");
+    std::mutex batchMutex;
+    std::condition_variable batchDone;
+    size_t remaining =
+        (misses.size() + measureChunkSize - 1) / measureChunkSize;
+    for (size_t begin = 0; begin < misses.size(); begin += measureChunkSize) {
+      size_t end = std::min(begin + measureChunkSize, misses.size());
+      LayoutThreadPool().Submit([&, begin, end](int worker) {
+        measureChunk(begin, end, worker + 1);
+        std::lock_guard<std::mutex> lock(batchMutex);
+        if (--remaining == 0) {
+          batchDone.notify_one();
+        }
+      });
+    }
+    std::unique_lock<std::mutex> lock(batchMutex);
+    batchDone.wait(lock, [&] { return remaining == 0; });
   }
-  if (fontMap != nullptr) {
-    g_object_unref(fontMap);
-  } else {
-    printf("Pango font map is null");
+
+  for (int i : misses) {
+    AddTextSize(keys[i], sizes[i]);
   }
-  pango_font_description_free(desc);
-  return t;
 }
+
+extern "C" UNITY_INTERFACE_EXPORT TextSize GetTextSize(char* data,
+                                                       char* fontname,
+                                                       char* fontface,
+                                                       int fontSize,
+                                                       float lineSpacing,
+                                                       _cairo_font_type ft,
+                                                       gboolean useMarkup) {
+  return GetTextSizeWithFontId(data, RegisterFont(fontname, fontface, ft),
+                               fontSize, lineSpacing, useMarkup);
+}
+
+// indexClusters builds the cluster geometry of r's layout if it has none yet.
+// r's lane mutex must be held, and r must not be published yet.
+static void indexClusters(RenderData* r) {
+  if (!r->clusterGeometry) {
+    r->clusterGeometry = BuildClusterGeometry(r, r->RenderWidthPixels(),
+                                              r->RenderHeightPixels());
+  }
+}
+
+// updateCopy applies setter to a copy of current, lays the copy out and
+// publishes it. The render thread can keep drawing current meanwhile. Nothing
+// is published if setter didn't change anything. current's lane mutex must be
+// held.
+template <typename Setter>
+static TextInfo updateCopy(unsigned int index,
+                           const std::shared_ptr<RenderData>& current,
+                           unsigned long long sequence,
+                           Setter setter) {
+  auto next = std::make_shared<RenderData>(*current);
+  setter(next.get());
+  if (!next->NeedsUpdate()) {
+    return current->GetTextInfo();
+  }
+  next->Update();
+  indexClusters(next.get());
+  next->sequence = sequence;
+  TextInfo info = next->GetTextInfo();
+  if (!publishRenderData(index, next)) {
+    // Superseded by a newer update.
+    std::shared_ptr<RenderData> newer = findRenderData(index);
+    return newer ? newer->GetTextInfo() : TextInfo();
+  }
+  schedulePreRasterization(index, std::move(next));
+  return info;
+}
+
+// TextDataRequest holds the SetTextData arguments, so that the layout can be
+// done later on a worker.
+struct TextDataRequest {
+  std::string text;
+  int fontId;
+  int fontSize;
+  int textBoxWidth;
+  int textBoxHeight;
+  Color color;
+  PangoAlignment textAlignment;
+  float lineSpacing;
+  gboolean justify;
+  gboolean autoDir;
+  PangoDirection dir;
+  VerticalAlignment va;
+  HorizontalWrapping wrappingH;
+  VerticalWrapping wrappingV;
+  gboolean useMarkup;
+  float resolutionMultiplier;
+  gboolean automaticPadding;
+  RenderPadding padding;
+};
+
+static std::shared_ptr<RenderData> createRenderData(
+    const TextDataRequest& request,
+    int lane) {
+  return std::make_shared<RenderData>(
+      request.text, request.textBoxWidth, request.textBoxHeight,
+      request.fontSize, request.textAlignment, request.fontId, request.color,
+      request.lineSpacing, request.justify, request.autoDir, request.dir,
+      request.va, GetRegisteredFontBackend(request.fontId), request.wrappingH,
+      request.wrappingV, request.useMarkup, request.resolutionMultiplier,
+      request.automaticPadding, request.padding, lane);
+}
+
+// layoutOnLane applies request to index using the given font map lane, whose
+// mutex must be held. An instance already in the lane is updated with only the
+// work the changed properties require, and identical arguments return the
+// cached TextInfo. Otherwise a new instance is laid out in the lane.
+static TextInfo layoutOnLane(unsigned int index,
+                             const TextDataRequest& request,
+                             unsigned long long sequence,
+                             int lane) {
+  std::shared_ptr<RenderData> current = findRenderData(index);
+  if (current && current->lane == lane) {
+    return updateCopy(index, current, sequence, [&](RenderData* r) {
+      r->SetText(request.text.c_str(), request.useMarkup);
+      r->SetFont(request.fontId);
+      r->SetFontSize(request.fontSize, request.resolutionMultiplier);
+      r->SetLineSpacing(request.lineSpacing);
+      r->SetColor(request.color);
+      r->SetAlignment(request.textAlignment, request.va, request.justify);
+      r->SetDirection(request.autoDir, request.dir);
+      r->SetTextBox(request.textBoxWidth, request.textBoxHeight);
+      r->SetWrapping(request.wrappingH, request.wrappingV);
+      r->SetPadding(request.automaticPadding, request.padding);
+    });
+  }
+
+  // The request sets every layout property, so an instance from another
+  // lane only passes on the settings SetTextData doesn't cover.
+  std::shared_ptr<RenderData> r = createRenderData(request, lane);
+  r->sequence = sequence;
+  if (current) {
+    r->premultipliedAlpha = current->premultipliedAlpha;
+    r->baseRaster = current->LatestRaster();
+    // These can change the layout, so the new instance is updated again.
+    r->SetOutputMode(current->outputMode);
+    r->SetDistanceFieldSpread(current->distanceFieldSpread);
+    r->SetViewport(current->viewportScrollY, current->viewportHeight);
+    r->Update();
+  }
+  indexClusters(r.get());
+  TextInfo info = r->GetTextInfo();
+  if (!publishRenderData(index, r)) {
+    // Torn down, or superseded by a newer update.
+    current = findRenderData(index);
+    return current ? current->GetTextInfo() : TextInfo();
+  }
+  schedulePreRasterization(index, std::move(r));
+  return info;
+}
+
+static TextInfo setTextData(unsigned int index,
+                            const TextDataRequest& request) {
+  waitForPendingLayouts(index);
+  reclaimRetired();
+  unsigned long long sequence = ++updateSequence;
+  std::unique_lock<std::mutex> laneLock;
+  std::shared_ptr<RenderData> current = lockCurrentLane(index, laneLock);
+  return layoutOnLane(index, request, sequence, current ? current->lane : 0);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+SetTextDataWithFontId(unsigned int index,
+                      char* data,
+                      int fontId,
+                      int fontSize,
+                      int textBoxWidth,
+                      int textBoxHeight,
+                      Color color,
+                      PangoAlignment textAlignment,
+                      float lineSpacing,
+                      gboolean justify,
+                      gboolean autoDir,
+                      PangoDirection dir,
+                      VerticalAlignment va,
+                      HorizontalWrapping wrappingH,
+                      VerticalWrapping wrappingV,
+                      gboolean useMarkup,
+                      float resolutionMultiplier,
+                      gboolean automaticPadding = true,
+                      int paddingLeft = 0,
+                      int paddingRight = 0,
+                      int paddingTop = 0,
+                      int paddingBottom = 0) {
+  RenderPadding padding = {paddingLeft, paddingRight, paddingTop,
+                           paddingBottom};
+  return setTextData(
+      index, {data, fontId, fontSize, textBoxWidth, textBoxHeight, color,
+              textAlignment, lineSpacing, justify, autoDir, dir, va, wrappingH,
+              wrappingV, useMarkup, resolutionMultiplier, automaticPadding,
+              padding});
+}
+
 extern "C" UNITY_INTERFACE_EXPORT TextInfo
 SetTextData(unsigned int index,
             char* data,
@@ -142,127 +538,665 @@ SetTextData(unsigned int index,
             int paddingRight = 0,
             int paddingTop = 0,
             int paddingBottom = 0) {
+  return SetTextDataWithFontId(
+      index, data, RegisterFont(fontname, facename, ft), fontSize,
+      textBoxWidth, textBoxHeight, color, textAlignment, lineSpacing, justify,
+      autoDir, dir, va, wrappingH, wrappingV, useMarkup, resolutionMultiplier,
+      automaticPadding, paddingLeft, paddingRight, paddingTop, paddingBottom);
+}
+
+// runLayoutJob lays out an async request on a worker's font map lane and
+// publishes it, unless a newer update was published first.
+static void runLayoutJob(unsigned int ticket,
+                         unsigned int index,
+                         const TextDataRequest& request,
+                         unsigned long long sequence,
+                         int lane) {
+  TextInfo info;
+  {
+    std::lock_guard<std::mutex> laneLock(FontMapLaneMutex(lane));
+    info = layoutOnLane(index, request, sequence, lane);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m);
+    auto it = layoutTickets.find(ticket);
+    if (it != layoutTickets.end()) {
+      it->second.done = true;
+      it->second.info = info;
+    }
+    if (--pendingLayouts[index] == 0) {
+      pendingLayouts.erase(index);
+    }
+  }
+  layoutDone.notify_all();
+  reclaimRetired();
+}
+
+// SetTextDataAsync queues the same work as SetTextDataWithFontId on the layout
+// workers and returns a ticket for PollLayout. Layouts for different labels
+// run in parallel, and the newest call for a label wins.
+extern "C" UNITY_INTERFACE_EXPORT unsigned int
+SetTextDataAsync(unsigned int index,
+                 char* data,
+                 int fontId,
+                 int fontSize,
+                 int textBoxWidth,
+                 int textBoxHeight,
+                 Color color,
+                 PangoAlignment textAlignment,
+                 float lineSpacing,
+                 gboolean justify,
+                 gboolean autoDir,
+                 PangoDirection dir,
+                 VerticalAlignment va,
+                 HorizontalWrapping wrappingH,
+                 VerticalWrapping wrappingV,
+                 gboolean useMarkup,
+                 float resolutionMultiplier,
+                 gboolean automaticPadding = true,
+                 int paddingLeft = 0,
+                 int paddingRight = 0,
+                 int paddingTop = 0,
+                 int paddingBottom = 0) {
   RenderPadding padding = {paddingLeft, paddingRight, paddingTop,
                            paddingBottom};
-  m.lock();
-  auto it = renderDataLUT.find(index);
-  if (it != renderDataLUT.end()) {
-    RenderData* renderData = it->second;
-    delete renderData;
-    renderDataLUT.erase(it);
-  }
-
-  auto r = new RenderData(
-      data, textBoxWidth, textBoxHeight, fontSize, textAlignment, fontname,
-      facename, color, lineSpacing, justify, autoDir, dir, va, ft, wrappingH,
-      wrappingV, useMarkup, resolutionMultiplier, automaticPadding, padding);
-  renderDataLUT[index] = r;
-  PangoRectangle inkRect;
-  PangoRectangle logicalRect;
-  pango_layout_get_extents(r->pangoLayout, &inkRect, &logicalRect);
-  PangoLayoutLine* line;
-  line = pango_layout_get_line(r->pangoLayout, 0);
-  PangoDirection direction = r->dir;
-  if (r->autoDir && LINE_IS_VALID(line)) {
-    direction = (PangoDirection)line->resolved_dir;
-  }
-
-  int lineCount = pango_layout_get_line_count(r->pangoLayout);
-  int characterCount = pango_layout_get_character_count(r->pangoLayout);
-  int ascent = 0;
-  int descent = 0;
-  int lineHeight = 0;
-  PangoFontMetrics* metrics = pango_context_get_metrics(
-      pango_layout_get_context(r->pangoLayout),
-      pango_layout_get_font_description(r->pangoLayout), nullptr);
-  if (metrics) {
-    ascent = pango_font_metrics_get_ascent(metrics) / PANGO_SCALE;
-    descent = pango_font_metrics_get_descent(metrics) / PANGO_SCALE;
-    lineHeight = pango_font_metrics_get_height(metrics) / PANGO_SCALE;
-    pango_font_metrics_unref(metrics);
-  }
-
-  TextInfo t = TextInfo(
-      r->RenderWidthPixels(), r->RenderHeightPixels(),
-      logicalRect.width / PANGO_SCALE, logicalRect.height / PANGO_SCALE,
-      inkRect.width / PANGO_SCALE, inkRect.height / PANGO_SCALE, direction,
-      lineCount, characterCount, ascent, descent, lineHeight);
-  m.unlock();
-  return t;
+  auto request = std::make_shared<TextDataRequest>(TextDataRequest{
+      data, fontId, fontSize, textBoxWidth, textBoxHeight, color,
+      textAlignment, lineSpacing, justify, autoDir, dir, va, wrappingH,
+      wrappingV, useMarkup, resolutionMultiplier, automaticPadding, padding});
+  unsigned long long sequence = ++updateSequence;
+  unsigned int ticket;
+  {
+    std::lock_guard<std::mutex> lock(m);
+    if (++nextTicket == 0) {
+      ++nextTicket;
+    }
+    ticket = nextTicket;
+    layoutTickets[ticket] = LayoutTicket();
+    pendingLayouts[index]++;
+  }
+  LayoutThreadPool().Submit([=](int worker) {
+    runLayoutJob(ticket, index, *request, sequence, worker + 1);
+  });
+  return ticket;
 }
 
-void renderToTexture(void* data) {
-  auto params = reinterpret_cast<UnityRenderingExtTextureUpdateParamsV2*>(data);
-  m.lock();
-
-  auto it = renderDataLUT.find(params->userData);
-  // only render something if we find the matching render data.
-  if (it == renderDataLUT.end()) {
-    m.unlock();
-    auto tex = new uint32_t[params->width * params->height];
-    for (unsigned int i = 0; i < params->width * params->height; ++i) {
-      tex[i] = 0x00000000;
+// PollLayout returns 1 and fills info once the ticket's layout is published,
+// after which the ticket is forgotten. It returns 0 while the layout is still
+// queued, and -1 for an unknown ticket.
+extern "C" UNITY_INTERFACE_EXPORT int PollLayout(unsigned int ticket,
+                                                 TextInfo* info) {
+  std::lock_guard<std::mutex> lock(m);
+  auto it = layoutTickets.find(ticket);
+  if (it == layoutTickets.end()) {
+    return -1;
+  }
+  if (!it->second.done) {
+    return 0;
+  }
+  if (info != nullptr) {
+    *info = it->second.info;
+  }
+  layoutTickets.erase(it);
+  return 1;
+}
+
+// updateRenderData applies a single property change to an existing instance
+// and returns its TextInfo, or an empty TextInfo if the index is unknown.
+template <typename Setter>
+static TextInfo updateRenderData(unsigned int index, Setter setter) {
+  waitForPendingLayouts(index);
+  reclaimRetired();
+  unsigned long long sequence = ++updateSequence;
+  std::unique_lock<std::mutex> laneLock;
+  std::shared_ptr<RenderData> current = lockCurrentLane(index, laneLock);
+  if (!current) {
+    return TextInfo();
+  }
+  return updateCopy(index, current, sequence, setter);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT TextInfo UpdateText(unsigned int index,
+                                                      char* data,
+                                                      gboolean useMarkup) {
+  return updateRenderData(
+      index, [&](RenderData* r) { r->SetText(data, useMarkup); });
+}
+
+// currentTextInfo returns the TextInfo of the published instance, or an empty
+// TextInfo if the index is unknown. Updates given bad input return it.
+static TextInfo currentTextInfo(unsigned int index) {
+  std::shared_ptr<RenderData> current = findRenderData(index);
+  return current ? current->GetTextInfo() : TextInfo();
+}
+
+// AppendText adds data to the end of a plain or marked up text, e.g. a line of
+// a log. Labels with a viewport (see UpdateViewport) only lay out the new
+// paragraphs and the window around the viewport again, and rasterize what
+// changed.
+extern "C" UNITY_INTERFACE_EXPORT TextInfo AppendText(unsigned int index,
+                                                      char* data) {
+  if (data == nullptr) {
+    return currentTextInfo(index);
+  }
+  return updateRenderData(index,
+                          [&](RenderData* r) { r->AppendText(data); });
+}
+
+// TrimText removes the first paragraphs of the text, e.g. to keep a log to a
+// number of lines. Marked up text is only cut between top level elements.
+extern "C" UNITY_INTERFACE_EXPORT TextInfo TrimText(unsigned int index,
+                                                    int paragraphs) {
+  if (paragraphs <= 0) {
+    return currentTextInfo(index);
+  }
+  return updateRenderData(index,
+                          [&](RenderData* r) { r->TrimText(paragraphs); });
+}
+
+extern "C" UNITY_INTERFACE_EXPORT TextInfo UpdateFont(unsigned int index,
+                                                      int fontId) {
+  return updateRenderData(index, [&](RenderData* r) { r->SetFont(fontId); });
+}
+
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdateFontSize(unsigned int index, int fontSize, float resolutionMultiplier) {
+  return updateRenderData(index, [&](RenderData* r) {
+    r->SetFontSize(fontSize, resolutionMultiplier);
+  });
+}
+
+extern "C" UNITY_INTERFACE_EXPORT TextInfo UpdateColor(unsigned int index,
+                                                       Color color) {
+  return updateRenderData(index, [&](RenderData* r) { r->SetColor(color); });
+}
+
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdateAlignment(unsigned int index,
+                PangoAlignment textAlignment,
+                VerticalAlignment va,
+                gboolean justify) {
+  return updateRenderData(index, [&](RenderData* r) {
+    r->SetAlignment(textAlignment, va, justify);
+  });
+}
+
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdateWrapping(unsigned int index,
+               int textBoxWidth,
+               int textBoxHeight,
+               HorizontalWrapping wrappingH,
+               VerticalWrapping wrappingV) {
+  return updateRenderData(index, [&](RenderData* r) {
+    r->SetTextBox(textBoxWidth, textBoxHeight);
+    r->SetWrapping(wrappingH, wrappingV);
+  });
+}
+
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdatePadding(unsigned int index,
+              gboolean automaticPadding,
+              int paddingLeft,
+              int paddingRight,
+              int paddingTop,
+              int paddingBottom) {
+  RenderPadding padding = {paddingLeft, paddingRight, paddingTop,
+                           paddingBottom};
+  return updateRenderData(index, [&](RenderData* r) {
+    r->SetPadding(automaticPadding, padding);
+  });
+}
+
+// growRect grows rect by margin on every side, within a width x height
+// surface.
+static TextureRect growRect(TextureRect rect,
+                            int margin,
+                            int width,
+                            int height) {
+  int x0 = std::max(rect.x - margin, 0);
+  int y0 = std::max(rect.y - margin, 0);
+  int x1 = std::min(rect.x + rect.width + margin, width);
+  int y1 = std::min(rect.y + rect.height + margin, height);
+  return TextureRect{x0, y0, x1 - x0, y1 - y0};
+}
+
+// drawDistanceFieldRegion computes the distance field of region from the
+// coverage of the region grown by the spread, which holds every edge close
+// enough to affect it, and writes it into buffer like drawRegion.
+static void drawDistanceFieldRegion(RenderData* rd,
+                                    cairo_surface_t* recording,
+                                    TextureBuffer* buffer,
+                                    int width,
+                                    int height,
+                                    RasterFormat format,
+                                    TextureRect region) {
+  TextureRect coverage = growRect(
+      region, (int)std::ceil(rd->distanceFieldSpread), width, height);
+  int stride = cairo_format_stride_for_width(CAIRO_FORMAT_A8, coverage.width);
+  auto scratch =
+      AcquireTextureBuffer(((size_t)stride * coverage.height + 3) / 4);
+  auto data = reinterpret_cast<unsigned char*>(scratch->pixels);
+  ReplayRegionToBuffer(recording, data, stride, coverage, CAIRO_FORMAT_A8);
+  ComputeDistanceField(data, stride, coverage.width, coverage.height,
+                       rd->distanceFieldSpread);
+  const unsigned char* field = data +
+                               (size_t)(region.y - coverage.y) * stride +
+                               (region.x - coverage.x);
+
+  int bytesPerPixel = RasterBytesPerPixel(format);
+  int textureStride = width * bytesPerPixel;
+  int textureY = height - region.y - region.height;
+  auto texture = reinterpret_cast<unsigned char*>(buffer->pixels) +
+                 (size_t)textureY * textureStride +
+                 (size_t)region.x * bytesPerPixel;
+  if (format == RasterAlpha8) {
+    ConvertFlip(field, stride, texture, textureStride, region.width,
+                region.height, format, true);
+    return;
+  }
+  // Colour formats get white with the field as alpha, so go through cairo's
+  // premultiplied layout like any other render.
+  auto white = AcquireTextureBuffer((size_t)region.width * region.height);
+  for (int y = 0; y < region.height; ++y) {
+    const unsigned char* fieldRow = field + (size_t)y * stride;
+    uint32_t* whiteRow = white->pixels + (size_t)y * region.width;
+    for (int x = 0; x < region.width; ++x) {
+      whiteRow[x] = fieldRow[x] * 0x01010101u;
     }
-    params->texData = tex;
+  }
+  ConvertFlip(reinterpret_cast<unsigned char*>(white->pixels),
+              region.width * 4, texture, textureStride, region.width,
+              region.height, format, rd->premultipliedAlpha);
+}
+
+// shiftRows moves the rows of a width x height texture in buffer as if the
+// content scrolled up by delta rows. The rows scrolled into view keep stale
+// pixels. Texture rows run bottom up.
+static void shiftRows(TextureBuffer* buffer,
+                      int width,
+                      int height,
+                      int bytesPerPixel,
+                      int delta) {
+  size_t stride = (size_t)width * bytesPerPixel;
+  auto data = reinterpret_cast<unsigned char*>(buffer->pixels);
+  if (delta > 0) {
+    memmove(data + delta * stride, data, (height - delta) * stride);
+  } else {
+    memmove(data, data - delta * stride, (height + delta) * stride);
+  }
+}
+
+// drawRegion redraws region of the label from its recording into buffer, which
+// holds a width x height texture in the given format, converting it to the
+// layout Unity expects.
+static void drawRegion(RenderData* rd,
+                       cairo_surface_t* recording,
+                       TextureBuffer* buffer,
+                       int width,
+                       int height,
+                       RasterFormat format,
+                       TextureRect region) {
+  if (rd->outputMode == OutputDistanceField) {
+    drawDistanceFieldRegion(rd, recording, buffer, width, height, format,
+                            region);
     return;
   }
+  cairo_format_t cairoFormat =
+      format == RasterAlpha8 ? CAIRO_FORMAT_A8 : CAIRO_FORMAT_ARGB32;
+  int stride = cairo_format_stride_for_width(cairoFormat, region.width);
+  auto scratch = AcquireTextureBuffer(((size_t)stride * region.height + 3) / 4);
+  auto data = reinterpret_cast<unsigned char*>(scratch->pixels);
+  ReplayRegionToBuffer(recording, data, stride, region, cairoFormat);
 
-  RenderData* rd = it->second;
-  cairo_surface_t* surface =
-      RenderToSurface(rd, (int)params->width, (int)params->height, false);
-  auto surfaceData = cairo_image_surface_get_data(surface);
-  int height = cairo_image_surface_get_height(surface);
-  int stride = cairo_image_surface_get_stride(surface);
-  int width = cairo_image_surface_get_width(surface);
-  
-  auto img = new uint32_t[params->width * params->height];
-
-  //memcpy(img, surfaceData, width * height * 4);
-
-  // this loop flips the code on the y axis so it is the right orientation
-  // for unity, and removed the premultiplied alpha.
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      int flippedY = height - y - 1;
-      int srcIndex = y * stride + x * 4;
-      int destIndex = flippedY * stride + x * 4;
-
-      u8 a = ((u8)surfaceData[srcIndex + 3]);
-      u8 r = ((u8)surfaceData[srcIndex + 0]);
-      u8 g = ((u8)surfaceData[srcIndex + 1]);
-      u8 b = (u8)surfaceData[srcIndex + 2];
-      float aFloat = ((float)a / 255.0);
-      if (a > 0) {
-        r /= aFloat;
-        g /= aFloat;
-        b /= aFloat;
-      }
-      img[destIndex / 4] = a << 24 | r << 16 | g << 8 | b;
+  // The region is flipped on its own, so its last row lands on the texture
+  // row that is lowest on screen.
+  int bytesPerPixel = RasterBytesPerPixel(format);
+  int textureStride = width * bytesPerPixel;
+  int textureY = height - region.y - region.height;
+  auto texture = reinterpret_cast<unsigned char*>(buffer->pixels) +
+                 (size_t)textureY * textureStride +
+                 (size_t)region.x * bytesPerPixel;
+  ConvertFlip(data, stride, texture, textureStride, region.width,
+              region.height, format, rd->premultipliedAlpha);
+}
+
+// rasterize renders the layout in the given format and publishes it as rd's
+// raster. If the label was rasterized at the same size and format before, only
+// the clusters that changed are redrawn. If another thread did so while the
+// caller waited for rd's raster mutex, that raster is returned instead. The
+// lane mutex is only taken to read the layout and record drawing it, so
+// layouts in the lane don't wait for the pixels; it must not be held by the
+// caller.
+static std::shared_ptr<RasterImage> rasterize(RenderData* rd,
+                                              int width,
+                                              int height,
+                                              RasterFormat format) {
+  std::lock_guard<std::mutex> rasterLock(rd->rasterMutex);
+  std::shared_ptr<RasterImage> image = rd->CachedRaster(width, height, format);
+  if (image) {
+    return image;
+  }
+
+  // Once unpublished, nothing can take a new reference to the previous raster,
+  // so its buffer can be reused if nothing else holds it. Don't touch a buffer
+  // Unity is still uploading from.
+  std::shared_ptr<RasterImage> previous =
+      std::atomic_exchange(&rd->raster, std::shared_ptr<RasterImage>());
+  std::shared_ptr<RasterImage> base =
+      std::atomic_exchange(&rd->baseRaster, std::shared_ptr<RasterImage>());
+  if (previous) {
+    base = std::move(previous);
+  }
+
+  auto next = std::make_shared<RasterImage>();
+  next->generation = rd->generation;
+  next->width = width;
+  next->height = height;
+  next->format = format;
+  next->premultipliedAlpha = rd->premultipliedAlpha;
+  next->version = ++rasterVersion;
+  {
+    std::lock_guard<std::mutex> laneLock(FontMapLaneMutex(rd->lane));
+    StampClusters(rd, width, height, &next->clusters);
+  }
+  next->scrollY = rd->ScrollY();
+
+  size_t pixelCount = (size_t)width * height;
+  int bytesPerPixel = RasterBytesPerPixel(format);
+  // Texture buffers count 32 bit words.
+  size_t bufferSize = (pixelCount * bytesPerPixel + 3) / 4;
+  TextureRect region = {0, 0, width, height};
+  bool scrolled = false;
+  int scrollDelta = 0;
+  if (base && base->width == width && base->height == height &&
+      base->format == format &&
+      base->premultipliedAlpha == rd->premultipliedAlpha) {
+    scrollDelta = next->scrollY - base->scrollY;
+    if (scrollDelta == 0) {
+      region = DamagedRegion(base->clusters, next->clusters, width, height);
+    } else if (std::abs(scrollDelta) < height) {
+      // The previous pixels are reused moved by the scroll, so compare with
+      // where their clusters end up.
+      region = ScrollDamagedRegion(base->clusters, next->clusters, scrollDelta,
+                                   width, height);
+      scrolled = true;
+    }
+    // A changed glyph moves the distance field as far as the spread.
+    if (rd->outputMode == OutputDistanceField && region.width > 0 &&
+        region.height > 0) {
+      region = growRect(region, (int)std::ceil(rd->distanceFieldSpread),
+                        width, height);
     }
   }
-  /*
-  for (int y = 0; y < height; ++y) {
-      for (int x = 0; x < width; ++x) {
-          int flippedY = height - y - 1;
-          int srcIndex = y * stride + x * 4;
-          int destIndex = flippedY * stride + x * 4;
-
-          u8 a = ((u8)surfaceData[srcIndex + 3]);
-          u8 r = ((u8)surfaceData[srcIndex + 0]);
-          u8 g = ((u8)surfaceData[srcIndex + 1]);
-          u8 b = (u8)surfaceData[srcIndex + 2];
-          img[destIndex / 4] = a << 24 | r << 16 | g << 8 | b;
-      }
-  }*/
+  bool baseHeld =
+      base && (base.use_count() > 1 || base->pixels.use_count() > 1);
+
+  // Everything that is drawn is replayed from a recording, which doesn't need
+  // the lane.
+  cairo_surface_t* recording = nullptr;
+  if (scrolled || !base || (region.width > 0 && region.height > 0)) {
+    std::lock_guard<std::mutex> laneLock(FontMapLaneMutex(rd->lane));
+    recording = RecordLayout(
+        rd, width, height,
+        format == RasterAlpha8 || rd->outputMode == OutputDistanceField);
+  }
+
+  // redraw draws a region over buffer, taking in the surroundings a distance
+  // field depends on.
+  auto redraw = [&](TextureBuffer* buffer, TextureRect rect) {
+    if (rd->outputMode == OutputDistanceField) {
+      rect = growRect(rect, (int)std::ceil(rd->distanceFieldSpread), width,
+                      height);
+    }
+    if (rect.width <= 0 || rect.height <= 0) {
+      return;
+    }
+    drawRegion(rd, recording, buffer, width, height, format, rect);
+    rasterStats.rasterizedBytes +=
+        (unsigned long long)rect.width * rect.height * bytesPerPixel;
+  };
+
+  if (scrolled) {
+    // Move the previous pixels, and draw the rows scrolled into view, what
+    // changed, and the watermark, which stays in place.
+    std::shared_ptr<TextureBuffer> buffer = base->pixels;
+    if (baseHeld) {
+      buffer = AcquireTextureBuffer(bufferSize);
+      buffer->size = bufferSize;
+      memcpy(buffer->pixels, base->pixels->pixels,
+             bufferSize * sizeof(uint32_t));
+    }
+    next->baseVersion = base->version;
+    base.reset();
+    shiftRows(buffer.get(), width, height, bytesPerPixel, scrollDelta);
+    TextureRect exposed =
+        scrollDelta > 0
+            ? TextureRect{0, height - scrollDelta, width, scrollDelta}
+            : TextureRect{0, 0, width, -scrollDelta};
+    TextureRect band = WatermarkBand(rd, width, height);
+    TextureRect movedBand = growRect(
+        TextureRect{band.x, band.y - scrollDelta, band.width, band.height}, 0,
+        width, height);
+    redraw(buffer.get(), exposed);
+    redraw(buffer.get(), region);
+    redraw(buffer.get(), band);
+    redraw(buffer.get(), movedBand);
+    next->pixels = std::move(buffer);
+    next->dirtyRect = TextureRect{0, 0, width, height};
+    rasterStats.partialRasterizations++;
+  } else if (base && (region.width == 0 || region.height == 0)) {
+    // Nothing visible changed, so the pixels can be shared.
+    next->pixels = base->pixels;
+    next->baseVersion = base->version;
+    next->dirtyRect = region;
+    rasterStats.unchangedRasterizations++;
+  } else if ((size_t)region.width * region.height * 2 < pixelCount) {
+    // Redraw the region over the previous pixels, in place unless something
+    // else holds them.
+    std::shared_ptr<TextureBuffer> buffer = base->pixels;
+    if (baseHeld) {
+      buffer = AcquireTextureBuffer(bufferSize);
+      buffer->size = bufferSize;
+      memcpy(buffer->pixels, base->pixels->pixels,
+             bufferSize * sizeof(uint32_t));
+    }
+    next->baseVersion = base->version;
+    base.reset();
+    drawRegion(rd, recording, buffer.get(), width, height, format, region);
+    next->pixels = std::move(buffer);
+    next->dirtyRect = TextureRect{region.x, height - region.y - region.height,
+                                  region.width, region.height};
+    rasterStats.rasterizedBytes +=
+        (unsigned long long)region.width * region.height * bytesPerPixel;
+    rasterStats.partialRasterizations++;
+  } else {
+    std::shared_ptr<TextureBuffer> buffer;
+    if (base && !baseHeld && base->pixels->capacity >= bufferSize) {
+      buffer = base->pixels;
+    } else {
+      buffer = AcquireTextureBuffer(bufferSize);
+    }
+    base.reset();
+    buffer->size = bufferSize;
+    if (bytesPerPixel != 4 || rd->outputMode == OutputDistanceField) {
+      drawRegion(rd, recording, buffer.get(), width, height, format, region);
+    } else {
+      // Replay straight into the texture buffer and convert it in place.
+      auto data = reinterpret_cast<unsigned char*>(buffer->pixels);
+      int stride = width * 4;
+      ReplayRegionToBuffer(recording, data, stride,
+                           TextureRect{0, 0, width, height},
+                           CAIRO_FORMAT_ARGB32);
+
+      // Flip on the y axis so it is the right orientation for unity, and
+      // remove the premultiplied alpha unless the caller wants it.
+      ConvertFlip(data, stride, data, stride, width, height, format,
+                  rd->premultipliedAlpha);
+    }
+    next->pixels = std::move(buffer);
+    next->baseVersion = 0;
+    next->dirtyRect = TextureRect{0, 0, width, height};
+    rasterStats.rasterizedBytes +=
+        (unsigned long long)pixelCount * bytesPerPixel;
+    rasterStats.fullRasterizations++;
+  }
+  if (recording != nullptr) {
+    cairo_surface_destroy(recording);
+  }
+
+  std::atomic_store(&rd->raster, next);
+  return next;
+}
+
+// schedulePreRasterization queues r to be rasterized at its render size on
+// the layout workers when pre-rasterization is on. Only recording the layout
+// holds the instance's font map lane, so the drawing runs in parallel with the
+// layouts and rasterizations in the same lane.
+static void schedulePreRasterization(unsigned int index,
+                                     std::shared_ptr<RenderData> r) {
+  if (!preRasterize || r->outputMode == OutputGlyphQuads ||
+      r->RenderWidthPixels() <= 0 ||
+      r->RenderHeightPixels() <= 0) {
+    return;
+  }
+  // Keep to the format the label's texture had last time, as that is what the
+  // texture update will ask for.
+  std::shared_ptr<RasterImage> last = r->LatestRaster();
+  RasterFormat format = last ? last->format : r->PreferredRasterFormat();
+  LayoutThreadPool().Submit([index, r, format](int) {
+    // Skip instances that were replaced before the job ran.
+    if (findRenderData(index) != r) {
+      return;
+    }
+    rasterize(r.get(), r->RenderWidthPixels(), r->RenderHeightPixels(),
+              format);
+  });
+}
+
+// SetPreRasterization turns on rasterizing labels on the layout workers as
+// soon as their layout is published, so the texture update on the render
+// thread only hands over the finished buffer. It is off by default, as it
+// rasterizes labels that may never be drawn.
+extern "C" UNITY_INTERFACE_EXPORT void SetPreRasterization(gboolean enabled) {
+  preRasterize = enabled != 0;
+}
+
+// UpdatePremultipliedAlpha switches the texture between straight alpha (the
+// default) and cairo's premultiplied alpha, which skips the un-premultiply
+// pass and keeps full precision at low alpha.
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdatePremultipliedAlpha(unsigned int index, gboolean premultipliedAlpha) {
+  return updateRenderData(index, [&](RenderData* r) {
+    r->SetPremultipliedAlpha(premultipliedAlpha);
+  });
+}
 
-  m.unlock();
-  params->texData = img;
-  cairo_surface_destroy(surface);
+// UpdateOutputMode selects whether the label is drawn from its own texture or
+// from glyph quads in the shared glyph atlas. Glyph quad labels are never
+// pre-rasterized.
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdateOutputMode(unsigned int index, OutputMode outputMode) {
+  return updateRenderData(index, [&](RenderData* r) {
+    if (outputMode >= OutputTexture && outputMode < OutputModeSentinel) {
+      r->SetOutputMode(outputMode);
+    }
+  });
+}
+
+// UpdateDistanceFieldSpread sets how many pixels the distance field of an
+// OutputDistanceField label spans on each side of the glyph edges. Larger
+// spreads allow thicker outlines and glows, at the cost of precision and of
+// as much padding around the text.
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdateDistanceFieldSpread(unsigned int index, float spread) {
+  return updateRenderData(index, [&](RenderData* r) {
+    if (spread >= 1.0f) {
+      r->SetDistanceFieldSpread(spread);
+    }
+  });
+}
+
+// UpdateViewport shows viewportHeight render pixels of the text from scrollY
+// down, so that long plain texts are only laid out and rasterized around the
+// viewport. Scrolling reuses the pixels still in view. A viewportHeight of 0
+// shows the whole text again.
+extern "C" UNITY_INTERFACE_EXPORT TextInfo UpdateViewport(unsigned int index,
+                                                          int scrollY,
+                                                          int viewportHeight) {
+  return updateRenderData(index, [&](RenderData* r) {
+    r->SetViewport(scrollY, viewportHeight);
+  });
+}
+
+// rasterFormatFor returns the raster format to write into the texture Unity is
+// updating, or RasterFormatSentinel if there is none.
+static RasterFormat rasterFormatFor(UnityRenderingExtTextureFormat format,
+                                    unsigned int bytesPerPixel) {
+  switch (format) {
+    case kUnityRenderingExtFormatA8_UNorm:
+    case kUnityRenderingExtFormatR8_UNorm:
+    case kUnityRenderingExtFormatR8_SRGB:
+      return RasterAlpha8;
+    case kUnityRenderingExtFormatR8G8B8A8_UNorm:
+    case kUnityRenderingExtFormatR8G8B8A8_SRGB:
+      return RasterRGBA32;
+    case kUnityRenderingExtFormatB8G8R8A8_UNorm:
+    case kUnityRenderingExtFormatB8G8R8A8_SRGB:
+      return RasterBGRA32;
+    case kUnityRenderingExtFormatR16G16B16A16_SFloat:
+      return RasterRGBAHalf;
+    default:
+      // Other 32 bit formats, e.g. the ARGB32 textures of older versions of
+      // the component, have always been sent RGBA32.
+      return bytesPerPixel == 4 ? RasterRGBA32 : RasterFormatSentinel;
+  }
+}
+
+void renderToTexture(void* data) {
+  auto params = reinterpret_cast<UnityRenderingExtTextureUpdateParamsV2*>(data);
+  // Holding a reference keeps this instance drawable even if an update
+  // publishes a new one meanwhile.
+  std::shared_ptr<RenderData> rd = findRenderData(params->userData);
+  RasterFormat format = rasterFormatFor(params->format, params->bpp);
+  // only render something if we find the matching render data, and can write
+  // the texture's format.
+  if (!rd || format == RasterFormatSentinel) {
+    size_t bytes = (size_t)params->width * params->height * params->bpp;
+    auto tex = AcquireTextureBuffer((bytes + 3) / 4);
+    memset(tex->pixels, 0, tex->size * sizeof(uint32_t));
+    std::lock_guard<std::mutex> lock(m);
+    params->texData = tex->pixels;
+    texturesInFlight[params->texData] = tex;
+    return;
+  }
+
+  int width = (int)params->width;
+  int height = (int)params->height;
+  // Static and pre-rasterized labels are served from the last rasterized
+  // texture, without waiting for a layout that is in progress.
+  std::shared_ptr<RasterImage> image =
+      rd->CachedRaster(width, height, format);
+  if (!image) {
+    image = rasterize(rd.get(), width, height, format);
+  }
+
+  // Hand the raster buffer to Unity without copying it. The in flight
+  // reference keeps it alive until releaseTexture, even if the label is torn
+  // down or re-rasterized meanwhile.
+  rasterStats.uploadedBytes +=
+      (unsigned long long)width * height * RasterBytesPerPixel(format);
+  std::lock_guard<std::mutex> lock(m);
+  params->texData = image->pixels->pixels;
+  texturesInFlight[params->texData] = image->pixels;
 }
 
 void releaseTexture(void* data) {
   auto params = reinterpret_cast<UnityRenderingExtTextureUpdateParamsV2*>(data);
-  delete[] reinterpret_cast<uint32_t*>(params->texData);
+  std::lock_guard<std::mutex> lock(m);
+  // Dropping the in flight reference returns the buffer to the pool, unless
+  // it is still the label's raster cache.
+  texturesInFlight.erase(params->texData);
 }
 
 void TextureUpdateCallback(int eventID, void* data) {
@@ -275,26 +1209,246 @@ void TextureUpdateCallback(int eventID, void* data) {
   }
 }
 
+// CopyTextureUpdate rasterizes the label at width x height in the given format
+// if needed, and copies the pixels that changed since the texture version the
+// caller holds to dst, row by row from the bottom of update->rect. Passing a
+// version of 0, or one the current texture wasn't derived from, copies the
+// whole texture. update is always filled in, and nothing is copied if dstSize
+// is smaller than the update, so the caller can retry with a larger buffer.
+// Returns false if the label doesn't exist or dst is too small.
+extern "C" UNITY_INTERFACE_EXPORT gboolean
+CopyTextureUpdate(unsigned int index,
+                  int width,
+                  int height,
+                  RasterFormat format,
+                  unsigned int version,
+                  unsigned char* dst,
+                  int dstSize,
+                  TextureUpdate* update) {
+  *update = TextureUpdate{{0, 0, 0, 0}, 0};
+  std::shared_ptr<RenderData> rd = findRenderData(index);
+  if (!rd || width <= 0 || height <= 0 || format < RasterRGBA32 ||
+      format >= RasterFormatSentinel) {
+    return false;
+  }
+  std::shared_ptr<RasterImage> image = rd->CachedRaster(width, height, format);
+  if (!image) {
+    image = rasterize(rd.get(), width, height, format);
+  }
+
+  update->version = image->version;
+  if (version == image->version) {
+    return true;
+  }
+  if (version != 0 && version == image->baseVersion) {
+    update->rect = image->dirtyRect;
+  } else {
+    update->rect = TextureRect{0, 0, width, height};
+  }
+  const TextureRect& rect = update->rect;
+  int bytesPerPixel = RasterBytesPerPixel(format);
+  size_t rowBytes = (size_t)rect.width * bytesPerPixel;
+  if (dst == nullptr || (size_t)dstSize < rowBytes * rect.height) {
+    return false;
+  }
+  auto texture = reinterpret_cast<const unsigned char*>(image->pixels->pixels);
+  for (int y = 0; y < rect.height; ++y) {
+    memcpy(dst + y * rowBytes,
+           texture + ((size_t)(rect.y + y) * width + rect.x) * bytesPerPixel,
+           rowBytes);
+  }
+  rasterStats.uploadedBytes += (unsigned long long)rowBytes * rect.height;
+  return true;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void GetRasterStats(RasterStats* stats) {
+  stats->rasterizedBytes = rasterStats.rasterizedBytes;
+  stats->uploadedBytes = rasterStats.uploadedBytes;
+  stats->fullRasterizations = rasterStats.fullRasterizations;
+  stats->partialRasterizations = rasterStats.partialRasterizations;
+  stats->unchangedRasterizations = rasterStats.unchangedRasterizations;
+}
+
 // GetCharacterRects returns a list of ink extents for each character in the
-// text.
+// text, in logical order. They are indexed once per layout, so this only
+// copies them.
 extern "C" UNITY_INTERFACE_EXPORT void GetCharacterRects(unsigned int index,
                                                          PangoRectangle* rects,
                                                          int count) {
-  m.lock();
-  auto it = renderDataLUT.find(index);
-
-  if (it == renderDataLUT.end()) {
-    m.unlock();
+  std::shared_ptr<RenderData> renderData = findRenderData(index);
+  if (!renderData || !renderData->clusterGeometry) {
     return;
   }
+  CopyClusterRects(*renderData->clusterGeometry, rects, count);
+}
 
-  RenderData* renderData = it->second;
-  // TODO: Get the width and height from the client, or always use the render
-  //  width & height of the RenderData, and enforce it when rendering to a
-  //  texture.
-  GetRenderedClusterRects(renderData, renderData->RenderWidthPixels(),
-                          renderData->RenderHeightPixels(), rects, count);
-  m.unlock();
+// GetClusterGeometry points view at the label's cluster geometry, which lives
+// until the next update or teardown of index. Returns false for an unknown
+// index.
+extern "C" UNITY_INTERFACE_EXPORT gboolean
+GetClusterGeometry(unsigned int index, ClusterGeometryView* view) {
+  std::shared_ptr<RenderData> renderData = findRenderData(index);
+  if (!renderData || !renderData->clusterGeometry) {
+    return false;
+  }
+  *view = ViewClusterGeometry(*renderData->clusterGeometry);
+  return true;
+}
+
+// HitTest returns the cluster at (x, y) in render pixels with y pointing down,
+// or the closest one for points outside the text. Returns -1 for an unknown
+// index or an empty label.
+extern "C" UNITY_INTERFACE_EXPORT int HitTest(unsigned int index,
+                                              int x,
+                                              int y) {
+  std::shared_ptr<RenderData> renderData = findRenderData(index);
+  if (!renderData || !renderData->clusterGeometry) {
+    return -1;
+  }
+  return HitTestClusters(*renderData->clusterGeometry, x, y);
+}
+
+// GetCaretRect writes the zero width caret in front of cluster to rect. Returns
+// false if index or cluster is unknown.
+extern "C" UNITY_INTERFACE_EXPORT gboolean GetCaretRect(unsigned int index,
+                                                        int cluster,
+                                                        PangoRectangle* rect) {
+  std::shared_ptr<RenderData> renderData = findRenderData(index);
+  if (!renderData || !renderData->clusterGeometry) {
+    return false;
+  }
+  return ClusterCaretRect(*renderData->clusterGeometry, cluster, rect);
+}
+
+// GetSelectionRects writes up to capacity rects highlighting clusters start up
+// to end, and returns how many the selection needs.
+extern "C" UNITY_INTERFACE_EXPORT int GetSelectionRects(unsigned int index,
+                                                        int start,
+                                                        int end,
+                                                        PangoRectangle* rects,
+                                                        int capacity) {
+  std::shared_ptr<RenderData> renderData = findRenderData(index);
+  if (!renderData || !renderData->clusterGeometry) {
+    return 0;
+  }
+  return ClusterSelectionRects(*renderData->clusterGeometry, start, end, rects,
+                               capacity);
+}
+
+// GetGlyphQuads writes up to capacity quads for the label's glyphs, positioned
+// in render pixels with y pointing down, and returns how many quads the label
+// needs. The quads sample the pages returned by CopyGlyphAtlasPage.
+extern "C" UNITY_INTERFACE_EXPORT int GetGlyphQuads(unsigned int index,
+                                                    GlyphQuad* quads,
+                                                    int capacity) {
+  std::shared_ptr<RenderData> renderData = findRenderData(index);
+  if (!renderData) {
+    return 0;
+  }
+
+  std::lock_guard<std::mutex> laneLock(FontMapLaneMutex(renderData->lane));
+  return BuildGlyphQuads(renderData.get(), renderData->RenderWidthPixels(),
+                         renderData->RenderHeightPixels(), quads, capacity);
+}
+
+static TextDataRequest requestFromDescriptor(const TextDataDescriptor& d) {
+  RenderPadding padding = {d.paddingLeft, d.paddingRight, d.paddingTop,
+                           d.paddingBottom};
+  return {d.text != nullptr ? d.text : "",
+          d.fontId,
+          d.fontSize,
+          d.textBoxWidth,
+          d.textBoxHeight,
+          d.color,
+          d.textAlignment,
+          d.lineSpacing,
+          d.justify,
+          d.autoDir,
+          d.dir,
+          d.va,
+          d.wrappingH,
+          d.wrappingV,
+          d.useMarkup,
+          d.resolutionMultiplier,
+          d.automaticPadding,
+          padding};
+}
+
+// SetTextDataBatch applies count TextDataDescriptors in one call, writing each
+// label's TextInfo to infos and its character rects to rects. The descriptors
+// are read with the stride given by the first one's size. With parallel set,
+// the labels are laid out on the layout workers and the call returns once all
+// of them are published. It returns the number of descriptors applied, or -1
+// if the descriptor size is unsupported.
+extern "C" UNITY_INTERFACE_EXPORT int SetTextDataBatch(
+    const void* descriptors,
+    int count,
+    TextInfo* infos,
+    PangoRectangle* rects,
+    int rectCapacity,
+    gboolean parallel) {
+  if (descriptors == nullptr || count <= 0) {
+    return 0;
+  }
+  auto bytes = static_cast<const unsigned char*>(descriptors);
+  unsigned int stride = reinterpret_cast<const TextDataDescriptor*>(bytes)->size;
+  if (stride < TextDataDescriptorMinSize) {
+    return -1;
+  }
+
+  std::vector<TextDataDescriptor> batch(count);
+  std::vector<TextDataRequest> requests;
+  requests.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    memcpy(&batch[i], bytes + (size_t)i * stride,
+           std::min((size_t)stride, sizeof(TextDataDescriptor)));
+    requests.push_back(requestFromDescriptor(batch[i]));
+  }
+
+  auto finishLabel = [&](int i, TextInfo info) {
+    if (infos != nullptr) {
+      infos[i] = info;
+    }
+    const TextDataDescriptor& d = batch[i];
+    if (rects != nullptr && d.rectCount > 0 && d.rectOffset >= 0 &&
+        d.rectCount <= rectCapacity - d.rectOffset) {
+      GetCharacterRects(d.index, rects + d.rectOffset, d.rectCount);
+    }
+  };
+
+  if (!parallel) {
+    for (int i = 0; i < count; ++i) {
+      finishLabel(i, setTextData(batch[i].index, requests[i]));
+    }
+    return count;
+  }
+
+  for (int i = 0; i < count; ++i) {
+    waitForPendingLayouts(batch[i].index);
+  }
+  reclaimRetired();
+  std::mutex batchMutex;
+  std::condition_variable batchDone;
+  int remaining = count;
+  for (int i = 0; i < count; ++i) {
+    unsigned long long sequence = ++updateSequence;
+    LayoutThreadPool().Submit([&, i, sequence](int worker) {
+      int lane = worker + 1;
+      TextInfo info;
+      {
+        std::lock_guard<std::mutex> laneLock(FontMapLaneMutex(lane));
+        info = layoutOnLane(batch[i].index, requests[i], sequence, lane);
+      }
+      finishLabel(i, info);
+      std::lock_guard<std::mutex> lock(batchMutex);
+      if (--remaining == 0) {
+        batchDone.notify_one();
+      }
+    });
+  }
+  std::unique_lock<std::mutex> lock(batchMutex);
+  batchDone.wait(lock, [&] { return remaining == 0; });
+  return count;
 }
 
 extern "C" UnityRenderingEventAndData UNITY_INTERFACE_EXPORT
@@ -4,7 +4,13 @@
 #include <pango/pango.h>
 #include <pango/pangocairo.h>
 #include <vector>
+#include "ClusterGeometry.h"
+#include "FontRegistry.h"
+#include "GlyphQuad.h"
+#include "OutputMode.h"
+#include "RasterDamage.h"
 #include "RenderData.h"
+#include "TextDataDescriptor.h"
 #include "TextInfo.h"
 #include "TextSize.h"
 #include "Unity/IUnityInterface.h"
@@ -22,6 +28,19 @@ extern "C" UNITY_INTERFACE_EXPORT TextSize GetTextSize(char* data,
                                                        float lineSpacing,
                                                        _cairo_font_type ft,
                                                        gboolean useMarkup);
+extern "C" UNITY_INTERFACE_EXPORT TextSize
+GetTextSizeWithFontId(char* data,
+                      int fontId,
+                      int fontSize,
+                      float lineSpacing,
+                      gboolean useMarkup);
+extern "C" UNITY_INTERFACE_EXPORT void GetTextSizes(const char** strings,
+                                                    int count,
+                                                    int fontId,
+                                                    int fontSize,
+                                                    float lineSpacing,
+                                                    gboolean useMarkup,
+                                                    TextSize* sizes);
 extern "C" UNITY_INTERFACE_EXPORT TextInfo
 SetTextData(unsigned int index,
             char* data,
@@ -48,11 +67,159 @@ SetTextData(unsigned int index,
             int paddingTop = 0,
             int paddingBottom = 0);
 
+// SetTextDataWithFontId is SetTextData for a font registered with
+// RegisterFont, so no font name lookups happen on update.
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+SetTextDataWithFontId(unsigned int index,
+                      char* data,
+                      int fontId,
+                      int fontSize,
+                      int textBoxWidth,
+                      int textBoxHeight,
+                      Color color,
+                      PangoAlignment textAlignment,
+                      float lineSpacing,
+                      gboolean justify,
+                      gboolean autoDir,
+                      PangoDirection dir,
+                      VerticalAlignment va,
+                      HorizontalWrapping wrappingH,
+                      VerticalWrapping wrappingV,
+                      gboolean useMarkup,
+                      float resolutionMultiplier,
+                      gboolean automaticPadding = true,
+                      int paddingLeft = 0,
+                      int paddingRight = 0,
+                      int paddingTop = 0,
+                      int paddingBottom = 0);
+
+// SetTextDataAsync queues SetTextDataWithFontId on the layout worker threads
+// and returns a ticket. PollLayout returns 1 and fills info once the layout is
+// published, 0 while it is queued, and -1 for an unknown ticket.
+extern "C" UNITY_INTERFACE_EXPORT unsigned int
+SetTextDataAsync(unsigned int index,
+                 char* data,
+                 int fontId,
+                 int fontSize,
+                 int textBoxWidth,
+                 int textBoxHeight,
+                 Color color,
+                 PangoAlignment textAlignment,
+                 float lineSpacing,
+                 gboolean justify,
+                 gboolean autoDir,
+                 PangoDirection dir,
+                 VerticalAlignment va,
+                 HorizontalWrapping wrappingH,
+                 VerticalWrapping wrappingV,
+                 gboolean useMarkup,
+                 float resolutionMultiplier,
+                 gboolean automaticPadding = true,
+                 int paddingLeft = 0,
+                 int paddingRight = 0,
+                 int paddingTop = 0,
+                 int paddingBottom = 0);
+extern "C" UNITY_INTERFACE_EXPORT int PollLayout(unsigned int ticket,
+                                                 TextInfo* info);
+
+// Per-property updates for an existing instance. Each one only redoes the work
+// the property requires: colour and vertical alignment skip the layout
+// entirely.
+extern "C" UNITY_INTERFACE_EXPORT TextInfo UpdateText(unsigned int index,
+                                                      char* data,
+                                                      gboolean useMarkup);
+extern "C" UNITY_INTERFACE_EXPORT TextInfo AppendText(unsigned int index,
+                                                      char* data);
+extern "C" UNITY_INTERFACE_EXPORT TextInfo TrimText(unsigned int index,
+                                                    int paragraphs);
+extern "C" UNITY_INTERFACE_EXPORT TextInfo UpdateFont(unsigned int index,
+                                                      int fontId);
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdateFontSize(unsigned int index, int fontSize, float resolutionMultiplier);
+extern "C" UNITY_INTERFACE_EXPORT TextInfo UpdateColor(unsigned int index,
+                                                       Color color);
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdateAlignment(unsigned int index,
+                PangoAlignment textAlignment,
+                VerticalAlignment va,
+                gboolean justify);
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdateWrapping(unsigned int index,
+               int textBoxWidth,
+               int textBoxHeight,
+               HorizontalWrapping wrappingH,
+               VerticalWrapping wrappingV);
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdatePadding(unsigned int index,
+              gboolean automaticPadding,
+              int paddingLeft,
+              int paddingRight,
+              int paddingTop,
+              int paddingBottom);
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdatePremultipliedAlpha(unsigned int index, gboolean premultipliedAlpha);
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdateOutputMode(unsigned int index, OutputMode outputMode);
+extern "C" UNITY_INTERFACE_EXPORT TextInfo
+UpdateDistanceFieldSpread(unsigned int index, float spread);
+extern "C" UNITY_INTERFACE_EXPORT TextInfo UpdateViewport(unsigned int index,
+                                                          int scrollY,
+                                                          int viewportHeight);
+
+// SetTextDataBatch applies count TextDataDescriptors, writing each label's
+// TextInfo to infos and its character rects to rects. With parallel set the
+// labels are laid out on the layout workers. It returns the number of labels
+// applied, or -1 if the descriptor size is unsupported.
+extern "C" UNITY_INTERFACE_EXPORT int SetTextDataBatch(
+    const void* descriptors,
+    int count,
+    TextInfo* infos,
+    PangoRectangle* rects,
+    int rectCapacity,
+    gboolean parallel);
+
+// SetPreRasterization turns on rasterizing labels on the layout workers as soon
+// as their layout is published, so the texture update only hands the finished
+// buffer to Unity.
+extern "C" UNITY_INTERFACE_EXPORT void SetPreRasterization(gboolean enabled);
+
 extern "C" UnityRenderingEventAndData UNITY_INTERFACE_EXPORT
 GetTextureUpdateCallback();
 
+// CopyTextureUpdate copies the pixels that changed since the caller's texture
+// version, so that Unity can upload only that part of the texture.
+extern "C" UNITY_INTERFACE_EXPORT gboolean
+CopyTextureUpdate(unsigned int index,
+                  int width,
+                  int height,
+                  RasterFormat format,
+                  unsigned int version,
+                  unsigned char* dst,
+                  int dstSize,
+                  TextureUpdate* update);
+extern "C" UNITY_INTERFACE_EXPORT void GetRasterStats(RasterStats* stats);
+
 extern "C" UNITY_INTERFACE_EXPORT void GetCharacterRects(unsigned int index,
                                                          PangoRectangle* rects,
                                                          int count);
+extern "C" UNITY_INTERFACE_EXPORT gboolean
+GetClusterGeometry(unsigned int index, ClusterGeometryView* view);
+extern "C" UNITY_INTERFACE_EXPORT int HitTest(unsigned int index,
+                                              int x,
+                                              int y);
+extern "C" UNITY_INTERFACE_EXPORT gboolean GetCaretRect(unsigned int index,
+                                                        int cluster,
+                                                        PangoRectangle* rect);
+extern "C" UNITY_INTERFACE_EXPORT int GetSelectionRects(unsigned int index,
+                                                        int start,
+                                                        int end,
+                                                        PangoRectangle* rects,
+                                                        int capacity);
+
+// GetGlyphQuads writes up to capacity quads for drawing the label from the
+// shared glyph atlas and returns the number of quads it needs.
+extern "C" UNITY_INTERFACE_EXPORT int GetGlyphQuads(unsigned int index,
+                                                    GlyphQuad* quads,
+                                                    int capacity);
 }  // namespace HQText
 #endif  // HQTEXTTEST_PLUGIN_H
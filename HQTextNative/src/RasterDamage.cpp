@@ -0,0 +1,91 @@
+#include "RasterDamage.h"
+#include <pango/pango.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+namespace HQText {
+
+TextureRect DamagedRegion(const std::vector<ClusterStamp>& before,
+                          const std::vector<ClusterStamp>& after,
+                          int surfaceWidth,
+                          int surfaceHeight) {
+  // Antialiasing and hinting may touch the pixels just outside the extents.
+  const int margin = 2;
+  long long left = LLONG_MAX, top = LLONG_MAX;
+  long long right = LLONG_MIN, bottom = LLONG_MIN;
+  auto add = [&](const ClusterStamp& stamp) {
+    left = std::min(left, (long long)stamp.x);
+    top = std::min(top, (long long)stamp.y);
+    right = std::max(right, (long long)stamp.x + stamp.width);
+    bottom = std::max(bottom, (long long)stamp.y + stamp.height);
+  };
+  // Both lists are sorted, so a merge finds the clusters that were only drawn
+  // by one of them. Clusters that moved show up in both.
+  size_t i = 0, j = 0;
+  while (i < before.size() || j < after.size()) {
+    if (j == after.size() || (i < before.size() && before[i] < after[j])) {
+      add(before[i++]);
+    } else if (i == before.size() || after[j] < before[i]) {
+      add(after[j++]);
+    } else {
+      i++;
+      j++;
+    }
+  }
+  if (left > right) {
+    return TextureRect{0, 0, 0, 0};
+  }
+
+  int x0 = (int)std::floor((double)left / PANGO_SCALE) - margin;
+  int y0 = (int)std::floor((double)top / PANGO_SCALE) - margin;
+  int x1 = (int)std::ceil((double)right / PANGO_SCALE) + margin;
+  int y1 = (int)std::ceil((double)bottom / PANGO_SCALE) + margin;
+  x0 = std::max(x0, 0);
+  y0 = std::max(y0, 0);
+  x1 = std::min(x1, surfaceWidth);
+  y1 = std::min(y1, surfaceHeight);
+  if (x1 <= x0 || y1 <= y0) {
+    return TextureRect{0, 0, 0, 0};
+  }
+  return TextureRect{x0, y0, x1 - x0, y1 - y0};
+}
+
+TextureRect ScrollDamagedRegion(const std::vector<ClusterStamp>& before,
+                                const std::vector<ClusterStamp>& after,
+                                int scrollDelta,
+                                int surfaceWidth,
+                                int surfaceHeight) {
+  // The rows that keep their previous pixels, in pango units. The rest were
+  // scrolled into view and are redrawn anyway.
+  int keptTop = std::max(-scrollDelta, 0) * PANGO_SCALE;
+  int keptBottom = (surfaceHeight - std::max(scrollDelta, 0)) * PANGO_SCALE;
+  auto kept = [&](const ClusterStamp& stamp) {
+    return stamp.y < keptBottom && stamp.y + stamp.height > keptTop;
+  };
+
+  // The previous clusters end up where their pixels were moved to, except
+  // for the surface stamp, which stays in place.
+  std::vector<ClusterStamp> moved;
+  moved.reserve(before.size());
+  for (ClusterStamp stamp : before) {
+    if (stamp.fontKey != SurfaceStampFontKey) {
+      stamp.y -= scrollDelta * PANGO_SCALE;
+    }
+    if (kept(stamp)) {
+      moved.push_back(stamp);
+    }
+  }
+  std::sort(moved.begin(), moved.end());
+
+  std::vector<ClusterStamp> visible;
+  visible.reserve(after.size());
+  for (const ClusterStamp& stamp : after) {
+    if (kept(stamp)) {
+      visible.push_back(stamp);
+    }
+  }
+  return DamagedRegion(moved, visible, surfaceWidth, surfaceHeight);
+}
+
+}  // namespace HQText
@@ -0,0 +1,86 @@
+#ifndef HQTEXT_RASTERDAMAGE_H
+#define HQTEXT_RASTERDAMAGE_H
+
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace HQText {
+
+// The font key of the stamp that covers the whole surface, which stands for
+// everything that affects all of it.
+const int SurfaceStampFontKey = -1;
+
+// ClusterStamp records what one cluster of a layout drew, so that two
+// rasterizations of a label can be compared without keeping the old layout.
+// The rect is the union of the cluster's ink and logical extents on the
+// surface, in pango units with y pointing down.
+struct ClusterStamp {
+  int x;
+  int y;
+  int width;
+  int height;
+  int fontKey;
+  // Hash of the cluster's glyphs and of the run's colours and decorations.
+  uint64_t content;
+
+  bool operator==(const ClusterStamp& other) const {
+    return x == other.x && y == other.y && width == other.width &&
+           height == other.height && fontKey == other.fontKey &&
+           content == other.content;
+  }
+  bool operator<(const ClusterStamp& other) const {
+    return std::tie(y, x, width, height, fontKey, content) <
+           std::tie(other.y, other.x, other.width, other.height,
+                    other.fontKey, other.content);
+  }
+};
+
+struct TextureRect {
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+// DamagedRegion returns the bounding box, in surface pixels with y pointing
+// down, of the clusters drawn by only one of the two sorted stamp lists. It is
+// empty if both drew the same.
+TextureRect DamagedRegion(const std::vector<ClusterStamp>& before,
+                          const std::vector<ClusterStamp>& after,
+                          int surfaceWidth,
+                          int surfaceHeight);
+
+// ScrollDamagedRegion is DamagedRegion for a surface whose previous pixels
+// were moved up by scrollDelta rows. The rows scrolled into view are left
+// out, as they are redrawn anyway.
+TextureRect ScrollDamagedRegion(const std::vector<ClusterStamp>& before,
+                                const std::vector<ClusterStamp>& after,
+                                int scrollDelta,
+                                int surfaceWidth,
+                                int surfaceHeight);
+
+// TextureUpdate describes the pixels CopyTextureUpdate copied.
+struct TextureUpdate {
+  // The region that changed, in texture pixels with row 0 at the bottom like
+  // Unity's textures. It is empty when nothing changed.
+  TextureRect rect;
+  // The version of the texture after applying the update.
+  unsigned int version;
+};
+
+struct RasterStats {
+  // Pixels drawn by cairo, in bytes. Partial updates only count the region
+  // that was redrawn.
+  unsigned long long rasterizedBytes;
+  // Bytes handed to Unity by the texture update callback and copied out by
+  // CopyTextureUpdate.
+  unsigned long long uploadedBytes;
+  unsigned long long fullRasterizations;
+  unsigned long long partialRasterizations;
+  // Rasterizations that found nothing changed and reused the previous pixels.
+  unsigned long long unchangedRasterizations;
+};
+
+}  // namespace HQText
+#endif  // HQTEXT_RASTERDAMAGE_H
@@ -0,0 +1,27 @@
+#ifndef HQTEXT_RASTERFORMAT_H
+#define HQTEXT_RASTERFORMAT_H
+namespace HQText {
+// RasterFormat is the pixel layout of a rasterized texture. Alpha8 holds only
+// the coverage of the text, one byte per pixel, and leaves applying the colour
+// to the shader. It suits labels drawn in a single colour. RGBAHalf holds a
+// half float per channel, for HDR textures.
+enum RasterFormat {
+  RasterRGBA32 = 0,
+  RasterAlpha8 = 1,
+  RasterBGRA32 = 2,
+  RasterRGBAHalf = 3,
+  RasterFormatSentinel = 4
+};
+
+inline int RasterBytesPerPixel(RasterFormat format) {
+  switch (format) {
+    case RasterAlpha8:
+      return 1;
+    case RasterRGBAHalf:
+      return 8;
+    default:
+      return 4;
+  }
+}
+}  // namespace HQText
+#endif  // HQTEXT_RASTERFORMAT_H
@@ -2,14 +2,31 @@
 #define HQTEXT_RENDERDATA_H
 
 #include <cairo.h>
+#include <hb-ot.h>
 #include <pango/pango.h>
 #include <pango/pangocairo.h>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
+#include "ClusterGeometry.h"
 #include "Color.h"
+#include "DistanceField.h"
 #include "FontConfig.h"
+#include "FontMapPool.h"
+#include "FontMetricsCache.h"
+#include "FontRegistry.h"
 #include "HorizontalWrapping.h"
+#include "OutputMode.h"
+#include "RasterDamage.h"
+#include "RasterFormat.h"
+#include "TextBlocks.h"
+#include "TextInfo.h"
+#include "TextureBufferPool.h"
 #include "VerticalAlignment.h"
 #include "VerticalWrapping.h"
 
@@ -22,19 +39,77 @@ struct RenderPadding {
   int bottom = 0;
 };
 
+// RasterImage is a rasterized texture of a RenderData, converted to the layout
+// Unity expects. It is never modified once published.
+struct RasterImage {
+  std::shared_ptr<TextureBuffer> pixels;
+  unsigned int generation;
+  int width;
+  int height;
+  RasterFormat format;
+  gboolean premultipliedAlpha;
+  // Identifies the pixels. Images that reuse the previous pixels unchanged
+  // get a new version too.
+  unsigned int version;
+  // The version this image was derived from, and the region that differs from
+  // it in texture pixels. Images drawn from scratch have a baseVersion of 0 and
+  // cover the whole texture.
+  unsigned int baseVersion;
+  TextureRect dirtyRect;
+  // What was drawn, to find the damaged region when the label is next
+  // rasterized.
+  std::vector<ClusterStamp> clusters;
+  // The viewport's scroll position the image was drawn at.
+  int scrollY = 0;
+};
+
+// Dirty bits set by the RenderData setters, from cheapest to most expensive to
+// resolve.
+enum RenderDataDirty : unsigned int {
+  DirtyNone = 0,
+  // Only the rasterized pixels change (e.g. colour).
+  DirtyRaster = 1 << 0,
+  // The layout moves inside the box but keeps its shape (vertical alignment).
+  DirtyOffset = 1 << 1,
+  // The text has to be shaped and broken into lines again.
+  DirtyLayout = 1 << 2,
+  // The layout needs a different font map or context (backend, direction).
+  DirtyContext = 1 << 3,
+  // The viewport scrolled to text that isn't laid out yet.
+  DirtyWindow = 1 << 4,
+};
+
 struct RenderData {
 #define DEVICE_DPI 72
 
  private:
   int renderWidth = 0;
   int renderHeight = 0;
+  unsigned int dirty = DirtyNone;
+  // Set on copies, which share the pango layout with the original until they
+  // need one of their own.
+  bool layoutShared = false;
+  TextInfo textInfo;
+  // Whether markup gives parts of the text their own colours, or a colour
+  // font (emoji) draws some of it, which rules out Alpha8 textures.
+  bool colorAttributes = false;
+  // With a viewport, the text is split into blocks, and pangoLayout only holds
+  // the window of blocks around the viewport. windowTop is where the window
+  // starts in the text, in pango units.
+  std::vector<TextBlock> blocks;
+  int windowFirstBlock = 0;
+  int windowEndBlock = 0;
+  int windowTop = 0;
+  // The estimates new blocks are split with.
+  int blockCharsPerLine = 0;
+  int blockLineHeight = 0;
 
  public:
   std::string text;
   int textBoxWidth = 0;
   int textBoxHeight = 0;
   int fontSize;
-  std::string fontName;
+  int fontId;
   float lineSpacingFactor;
   Color fontColor;
   PangoAlignment textAlignment;  // PangoAlignment
@@ -43,15 +118,86 @@ struct RenderData {
   gboolean autoDir;
   PangoDirection dir;
   VerticalAlignment verticalAlignment;
-  PangoFontDescription* fontDescription;
-  PangoFontMap* fontMap;
-  PangoContext* pangoContext;
-  PangoLayout* pangoLayout;
+  PangoFontDescription* fontDescription = nullptr;
+  PangoFontMap* fontMap = nullptr;
+  PangoContext* pangoContext = nullptr;
+  PangoLayout* pangoLayout = nullptr;
   HorizontalWrapping horizontalWrapping;
   VerticalWrapping verticalWrapping;
   gboolean useMarkup;
   float resolutionMultiplier;
+  bool automaticPadding;
+  // The padding passed in by the caller, and the padding in use (which is
+  // calculated when automaticPadding is enabled).
+  RenderPadding requestedPadding;
   RenderPadding padding;
+  // Output cairo's premultiplied alpha colours instead of straight alpha.
+  gboolean premultipliedAlpha = false;
+  // Whether the label is drawn from a texture or from glyph quads.
+  OutputMode outputMode = OutputTexture;
+  // How far, in pixels, a distance field falls off around the glyphs. The
+  // layout is padded by as much so the field isn't cut off.
+  float distanceFieldSpread = DefaultDistanceFieldSpread;
+  // The part of a long text that is shown, in render pixels. A viewport height
+  // of 0 shows the whole text.
+  int viewportScrollY = 0;
+  int viewportHeight = 0;
+  // The font map lane the pango objects come from. They must only be used
+  // with FontMapLaneMutex(lane) held.
+  int lane = 0;
+  // Incremented by Update() whenever the rendered pixels may have changed.
+  unsigned int generation = 0;
+  // Orders the updates that race to replace this instance.
+  unsigned long long sequence = 0;
+  // The last rasterized texture. It is replaced by the render thread and the
+  // pre-rasterization workers, so it must only be accessed with
+  // std::atomic_load and friends. Its pixels are handed to Unity directly, so
+  // they are shared with any texture update still in flight.
+  std::shared_ptr<RasterImage> raster;
+  // The raster of the instance this one was copied from, which the first
+  // rasterization only redraws the changed parts of. Like raster, it must
+  // only be accessed with std::atomic_load and friends.
+  std::shared_ptr<RasterImage> baseRaster;
+  // Serializes rasterizing this instance, which only holds the lane mutex
+  // while it reads the layout. It isn't copied.
+  std::mutex rasterMutex;
+  // Where the clusters of the layout are drawn at the render size. It is
+  // built before the instance is published, and shared with copies until
+  // their layout changes.
+  std::shared_ptr<const ClusterGeometry> clusterGeometry;
+
+  // LatestRaster returns the raster, or the base raster if there is none yet.
+  std::shared_ptr<RasterImage> LatestRaster() const {
+    std::shared_ptr<RasterImage> image = std::atomic_load(&raster);
+    return image ? image : std::atomic_load(&baseRaster);
+  }
+
+  // CachedRaster returns the last rasterized texture if it is up to date and
+  // of the given size and format, or null.
+  std::shared_ptr<RasterImage> CachedRaster(int width,
+                                            int height,
+                                            RasterFormat format) const {
+    std::shared_ptr<RasterImage> image = std::atomic_load(&raster);
+    if (image && image->generation == generation && image->width == width &&
+        image->height == height && image->format == format) {
+      return image;
+    }
+    return nullptr;
+  }
+
+  // Virtualized reports whether only the text around the viewport is laid
+  // out. Markup can span paragraphs, so marked up text is always laid out
+  // whole.
+  bool Virtualized() const { return viewportHeight > 0 && !useMarkup; }
+
+  // ScrollY returns how far the text is scrolled up, in render pixels.
+  int ScrollY() const { return Virtualized() ? viewportScrollY : 0; }
+
+  // WindowOffsetY returns where the top of the laid out window is drawn on a
+  // virtualized label's surface.
+  int WindowOffsetY() const {
+    return padding.top + windowTop / PANGO_SCALE - viewportScrollY;
+  }
 
   int RenderWidthPixels() { return renderWidth / PANGO_SCALE; }
   int RenderHeightPixels() { return renderHeight / PANGO_SCALE; }
@@ -61,8 +207,7 @@ struct RenderData {
              int tbh,
              int fs,
              PangoAlignment ta,
-             std::string fn,
-             std::string face,
+             int fid,
              Color fc,
              float lsf,
              gboolean j,
@@ -74,15 +219,16 @@ struct RenderData {
              VerticalWrapping wrappingV,
              gboolean shouldUseMarkup,
              float resolutionMultp,
-             bool automaticPadding = true,
-             RenderPadding _padding = {}) {
+             bool _automaticPadding = true,
+             RenderPadding _padding = {},
+             int _lane = 0) {
     fontType = ft;
     text = std::move(t);
     textBoxWidth = tbw;
     textBoxHeight = tbh;
     fontSize = fs;
     textAlignment = ta;
-    fontName = fn;
+    fontId = fid;
     fontColor = fc;
     lineSpacingFactor = lsf;
     justify = j;
@@ -93,76 +239,415 @@ struct RenderData {
     verticalWrapping = wrappingV;
     useMarkup = shouldUseMarkup;
     resolutionMultiplier = resolutionMultp;
+    automaticPadding = _automaticPadding;
+    requestedPadding = _padding;
     padding = _padding;
+    lane = _lane;
 
-    fontMap = pango_cairo_font_map_new_for_font_type(ft);
-    pangoContext = pango_font_map_create_context(fontMap);
-    pangoLayout = pango_layout_new(pangoContext);
+    dirty = DirtyContext | DirtyLayout | DirtyRaster;
+    Update();
+  }
 
-    // Disable ClearType antialiasing
-    // TODO: only do this for win32 as it doesn't seem to affect FreeType (perhaps due to setting on font.conf?)
-    {
-        auto font_options = cairo_font_options_create();
-        cairo_font_options_set_antialias(font_options, CAIRO_ANTIALIAS_GRAY);
-        pango_cairo_context_set_font_options(pangoContext, font_options);
-        cairo_font_options_destroy(font_options);
-    }
+  // The copy holds its own references to the pango objects and gets a new
+  // layout from Update() if its layout properties change, so the original can
+  // still be drawn while the copy is modified. The raster cache isn't copied,
+  // as the render thread may be writing it, but the latest image becomes the
+  // copy's base raster.
+  RenderData(const RenderData& other)
+      : renderWidth(other.renderWidth),
+        renderHeight(other.renderHeight),
+        layoutShared(true),
+        textInfo(other.textInfo),
+        colorAttributes(other.colorAttributes),
+        blocks(other.blocks),
+        windowFirstBlock(other.windowFirstBlock),
+        windowEndBlock(other.windowEndBlock),
+        windowTop(other.windowTop),
+        blockCharsPerLine(other.blockCharsPerLine),
+        blockLineHeight(other.blockLineHeight),
+        text(other.text),
+        textBoxWidth(other.textBoxWidth),
+        textBoxHeight(other.textBoxHeight),
+        fontSize(other.fontSize),
+        fontId(other.fontId),
+        lineSpacingFactor(other.lineSpacingFactor),
+        fontColor(other.fontColor),
+        textAlignment(other.textAlignment),
+        fontType(other.fontType),
+        justify(other.justify),
+        autoDir(other.autoDir),
+        dir(other.dir),
+        verticalAlignment(other.verticalAlignment),
+        fontDescription(pango_font_description_copy(other.fontDescription)),
+        fontMap(other.fontMap),
+        pangoContext(other.pangoContext),
+        pangoLayout(other.pangoLayout),
+        horizontalWrapping(other.horizontalWrapping),
+        verticalWrapping(other.verticalWrapping),
+        useMarkup(other.useMarkup),
+        resolutionMultiplier(other.resolutionMultiplier),
+        automaticPadding(other.automaticPadding),
+        requestedPadding(other.requestedPadding),
+        padding(other.padding),
+        premultipliedAlpha(other.premultipliedAlpha),
+        outputMode(other.outputMode),
+        distanceFieldSpread(other.distanceFieldSpread),
+        viewportScrollY(other.viewportScrollY),
+        viewportHeight(other.viewportHeight),
+        lane(other.lane),
+        generation(other.generation),
+        sequence(other.sequence),
+        baseRaster(other.LatestRaster()),
+        clusterGeometry(other.clusterGeometry) {
+    g_object_ref(fontMap);
+    g_object_ref(pangoContext);
+    g_object_ref(pangoLayout);
+  }
+  RenderData& operator=(const RenderData&) = delete;
 
-    char* fnAsChar = nullptr;
-    char* faceAsChar = nullptr;
-    if (!fn.empty()) {
-      fnAsChar = const_cast<char*>(fn.data());
+  void SetText(const char* t, gboolean shouldUseMarkup) {
+    if (useMarkup != shouldUseMarkup || text != t) {
+      text = t;
+      useMarkup = shouldUseMarkup;
+      dirty |= DirtyLayout;
     }
+  }
 
-    if (!face.empty()) {
-      faceAsChar = const_cast<char*>(face.data());
+  // AppendText adds text to the end. A virtualized label only splits the new
+  // text, along with the paragraph it continues, into blocks, and lays out
+  // the window around the viewport again.
+  void AppendText(const char* t) {
+    if (t == nullptr || *t == '\0') {
+      return;
     }
+    text += t;
+    if (!Virtualized() || blocks.empty()) {
+      dirty |= DirtyLayout;
+      return;
+    }
+    // The last block ends at the end of the old text.
+    int from = blocks.back().start;
+    blocks.pop_back();
+    std::vector<TextBlock> added = SplitTextBlocks(
+        text, from, (int)text.size(), blockCharsPerLine, blockLineHeight);
+    blocks.insert(blocks.end(), added.begin(), added.end());
+    dirty |= DirtyWindow;
+  }
 
-    if (fnAsChar == nullptr || faceAsChar == nullptr) {
-      pango_font_description_from_string("Sans");
+  // TrimText removes the first paragraphs of the text. In markup, only line
+  // breaks outside any element end a paragraph, so an element spanning
+  // several lines goes as a whole. A virtualized label keeps the blocks after
+  // them and lays out the window around the viewport again. The viewport
+  // stays where it is, so the text scrolls up by the height removed.
+  void TrimText(int paragraphs) {
+    size_t cut = 0;
+    for (int p = 0; p < paragraphs && cut < text.size(); ++p) {
+      cut = NextParagraphStart(text, cut, useMarkup);
+    }
+    if (cut == 0) {
+      return;
+    }
+    if (Virtualized() && !blocks.empty()) {
+      size_t b = 0;
+      while (b < blocks.size() &&
+             (size_t)(blocks[b].start + blocks[b].length) < cut) {
+        b++;
+      }
+      std::vector<TextBlock> kept;
+      if (b < blocks.size() && (size_t)blocks[b].start < cut) {
+        // The cut falls inside this block, so split what is left of it again.
+        kept = SplitTextBlocks(text, (int)cut,
+                               blocks[b].start + blocks[b].length,
+                               blockCharsPerLine, blockLineHeight);
+        b++;
+      }
+      kept.insert(kept.end(), blocks.begin() + b, blocks.end());
+      if (kept.empty()) {
+        // Everything went, down to a carriage return left out of the blocks.
+        kept = SplitTextBlocks(text, (int)cut, (int)text.size(),
+                               blockCharsPerLine, blockLineHeight);
+      }
+      for (TextBlock& block : kept) {
+        block.start -= (int)cut;
+      }
+      blocks = std::move(kept);
+      dirty |= DirtyWindow;
     } else {
-      fontDescription =
-          GetFontDescriptionFromString(fnAsChar, faceAsChar, fontType);
-    }
-    if (fontDescription == nullptr) {
-      printf("Could not find font (%s:%s), falling back to default font.\n",
-             fontName.c_str(), face.c_str());
-
-      // Create a default font description if GetFontDescriptionFromString
-      // returns null
-      fontDescription = pango_font_description_from_string("Sans");
-      if (fontDescription == nullptr) {
-        printf("Could not find default font (Sans)");
+      dirty |= DirtyLayout;
+    }
+    text.erase(0, cut);
+  }
+
+  void SetFont(int fid) {
+    if (fontId != fid) {
+      fontId = fid;
+      dirty |= DirtyLayout;
+      _cairo_font_type ft = GetRegisteredFontBackend(fid);
+      if (ft != fontType) {
+        fontType = ft;
+        dirty |= DirtyContext;
+      }
+    }
+  }
+
+  void SetFontSize(int fs, float resolutionMultp) {
+    if (fontSize != fs || resolutionMultiplier != resolutionMultp) {
+      fontSize = fs;
+      resolutionMultiplier = resolutionMultp;
+      dirty |= DirtyLayout;
+    }
+  }
+
+  void SetLineSpacing(float lsf) {
+    if (lineSpacingFactor != lsf) {
+      lineSpacingFactor = lsf;
+      dirty |= DirtyLayout;
+    }
+  }
+
+  void SetColor(Color fc) {
+    if (fontColor.r != fc.r || fontColor.g != fc.g || fontColor.b != fc.b ||
+        fontColor.a != fc.a) {
+      fontColor = fc;
+      dirty |= DirtyRaster;
+    }
+  }
+
+  void SetAlignment(PangoAlignment ta, VerticalAlignment va, gboolean j) {
+    // Pango aligns each line itself, so horizontal alignment and
+    // justification need a new layout.
+    if (textAlignment != ta || justify != j) {
+      textAlignment = ta;
+      justify = j;
+      dirty |= DirtyLayout;
+    }
+    if (verticalAlignment != va) {
+      verticalAlignment = va;
+      dirty |= DirtyOffset;
+    }
+  }
+
+  void SetPremultipliedAlpha(gboolean premultiplied) {
+    if (premultipliedAlpha != premultiplied) {
+      premultipliedAlpha = premultiplied;
+      dirty |= DirtyRaster;
+    }
+  }
+
+  void SetOutputMode(OutputMode mode) {
+    if (outputMode != mode) {
+      // Distance fields change the padding.
+      if (outputMode == OutputDistanceField || mode == OutputDistanceField) {
+        dirty |= DirtyLayout;
+      }
+      outputMode = mode;
+      dirty |= DirtyRaster;
+    }
+  }
+
+  void SetDistanceFieldSpread(float spread) {
+    if (distanceFieldSpread != spread) {
+      distanceFieldSpread = spread;
+      dirty |= outputMode == OutputDistanceField ? DirtyLayout : DirtyRaster;
+    }
+  }
+
+  void SetDirection(gboolean autoDirection, PangoDirection direction) {
+    if (autoDir != autoDirection) {
+      autoDir = autoDirection;
+      dirty |= DirtyLayout;
+    }
+    if (dir != direction) {
+      dir = direction;
+      dirty |= DirtyContext;
+    }
+  }
+
+  void SetTextBox(int tbw, int tbh) {
+    if (textBoxWidth != tbw || textBoxHeight != tbh) {
+      textBoxWidth = tbw;
+      textBoxHeight = tbh;
+      dirty |= DirtyLayout;
+    }
+  }
+
+  void SetWrapping(HorizontalWrapping wrappingH, VerticalWrapping wrappingV) {
+    if (horizontalWrapping != wrappingH || verticalWrapping != wrappingV) {
+      horizontalWrapping = wrappingH;
+      verticalWrapping = wrappingV;
+      dirty |= DirtyLayout;
+    }
+  }
+
+  void SetPadding(bool _automaticPadding, RenderPadding _padding) {
+    if (automaticPadding != _automaticPadding ||
+        (!_automaticPadding &&
+         (requestedPadding.left != _padding.left ||
+          requestedPadding.right != _padding.right ||
+          requestedPadding.top != _padding.top ||
+          requestedPadding.bottom != _padding.bottom))) {
+      automaticPadding = _automaticPadding;
+      requestedPadding = _padding;
+      dirty |= DirtyLayout;
+    }
+  }
+
+  // SetViewport shows height render pixels of the text from scrollY down.
+  // Scrolling within the laid out window only moves it.
+  void SetViewport(int scrollY, int height) {
+    scrollY = std::max(scrollY, 0);
+    height = std::max(height, 0);
+    if (viewportHeight != height) {
+      viewportHeight = height;
+      viewportScrollY = scrollY;
+      dirty |= DirtyLayout;
+      return;
+    }
+    if (viewportScrollY != scrollY) {
+      viewportScrollY = scrollY;
+      if (!Virtualized()) {
+        return;
+      }
+      if (blocks.empty()) {
+        // Not split into blocks yet.
+        dirty |= DirtyLayout;
+        return;
+      }
+      int first, end;
+      blockRange(scrollY, scrollY + height, &first, &end);
+      if (first < windowFirstBlock || end > windowEndBlock) {
+        dirty |= DirtyWindow;
+      } else {
+        dirty |= DirtyOffset;
       }
     }
+  }
+
+  bool NeedsUpdate() const { return dirty != DirtyNone; }
 
-    faceAsChar = nullptr;
-    fnAsChar = nullptr;
+  // Update does the minimum work required by the pending dirty bits. Colour
+  // and vertical alignment changes need no work here, as they are applied
+  // when rendering.
+  void Update() {
+    if (dirty & DirtyContext) {
+      replaceContext();
+      dirty |= DirtyLayout;
+    }
+    if (dirty & (DirtyLayout | DirtyWindow)) {
+      if (layoutShared) {
+        g_object_unref(pangoLayout);
+        pangoLayout = pango_layout_new(pangoContext);
+        layoutShared = false;
+      }
+      // Scrolling to another window keeps the blocks measured so far.
+      if (dirty & DirtyLayout) {
+        blocks.clear();
+      }
+      int passes = layout();
+      textInfo = calculateTextInfo();
+      textInfo.layoutPasses = passes;
+      colorAttributes = (useMarkup && hasColorAttributes()) || hasColorFont();
+    }
+    if (dirty & (DirtyOffset | DirtyLayout | DirtyWindow)) {
+      clusterGeometry = nullptr;
+    }
+    if (dirty != DirtyNone) {
+      generation++;
+    }
+    dirty = DirtyNone;
+  }
+
+  // GetTextInfo returns the size and metrics of the current layout, which are
+  // computed once per layout by Update().
+  TextInfo GetTextInfo() const {
+    TextInfo info = textInfo;
+    info.premultipliedAlpha = premultipliedAlpha;
+    info.preferredTextureFormat = PreferredRasterFormat();
+    // The texture update writes the format of the texture it is given.
+    std::shared_ptr<RasterImage> image = LatestRaster();
+    info.textureFormat = image ? image->format : info.preferredTextureFormat;
+    return info;
+  }
+
+  // PreferredRasterFormat returns Alpha8 unless markup or a colour font colours
+  // parts of the text, as the colour of a single colour label can be applied
+  // by the shader.
+  // Distance fields hold no colour either way.
+  RasterFormat PreferredRasterFormat() const {
+    if (outputMode == OutputDistanceField) {
+      return RasterAlpha8;
+    }
+    return colorAttributes ? RasterRGBA32 : RasterAlpha8;
+  }
+
+  ~RenderData() {
+    pango_font_description_free(fontDescription);
+    if (pangoLayout != nullptr) {
+      g_object_unref(pangoLayout);
+    } else {
+      printf("Renderer.cpp line is null ( g_object_unref(pangoLayout);)");
+    }
+    if (pangoContext != nullptr) {
+      g_object_unref(pangoContext);
+    } else {
+      printf("Renderer.cpp line is null ( g_object_unref(pangoContext);)");
+    }
+    if (fontMap != nullptr) {
+      g_object_unref(fontMap);
+    } else {
+      printf("Renderer.cpp line is null ( g_object_unref(fontMap);)");
+    }
+  }
+
+ private:
+  void replaceContext() {
+    if (pangoLayout != nullptr) {
+      g_object_unref(pangoLayout);
+    }
+    if (pangoContext != nullptr) {
+      g_object_unref(pangoContext);
+    }
+    if (fontMap != nullptr) {
+      g_object_unref(fontMap);
+    }
+    // The font map and context are shared between all labels in the lane using
+    // the same backend and direction, so their font caches stay warm across updates.
+    fontMap = AcquireFontMap(fontType, lane);
+    pangoContext = AcquireContext(fontType, dir, CAIRO_ANTIALIAS_GRAY, lane);
+    pangoLayout = pango_layout_new(pangoContext);
+    layoutShared = false;
+  }
+
+  // layout lays the text out in the text box and sizes the render target,
+  // returning how many times pango had to lay it out.
+  int layout() {
+    if (fontDescription != nullptr) {
+      pango_font_description_free(fontDescription);
+    }
+    fontDescription = CreateFontDescription(fontId, lane);
+    padding = requestedPadding;
     double scaledFontSize =
         std::max((double)fontSize, 1.0) * resolutionMultiplier * PANGO_SCALE;
 
     pango_font_description_set_absolute_size(fontDescription, scaledFontSize);
 
-    int ascent = 0;
-    int lineHeight = 0;
-    PangoFontMetrics* metrics = pango_context_get_metrics(
-        pango_layout_get_context(pangoLayout),
-        pango_layout_get_font_description(pangoLayout), nullptr);
-    if (metrics) {
-      ascent = pango_font_metrics_get_ascent(metrics) / PANGO_SCALE;
-      lineHeight = (pango_font_metrics_get_ascent(metrics) +
-                    pango_font_metrics_get_descent(metrics)) /
-                   PANGO_SCALE;
-
-      if (lineSpacingFactor != 0) {
-        lineHeight = lineSpacingFactor - lineHeight;
-        pango_layout_set_spacing(pangoLayout, lineHeight * PANGO_SCALE);
-      }
-      pango_font_metrics_unref(metrics);
+    pango_layout_set_spacing(pangoLayout, 0);
+    FontMetrics metrics = GetFontMetrics(
+        fontId, pango_layout_get_context(pangoLayout), fontDescription);
+    if (lineSpacingFactor != 0) {
+      // The spacing has always been measured from the context's default font,
+      // so existing labels keep their line pitch.
+      FontMetrics spacingMetrics =
+          GetContextFontMetrics(pango_layout_get_context(pangoLayout));
+      int lineHeight =
+          (spacingMetrics.ascent + spacingMetrics.descent) / PANGO_SCALE;
+      lineHeight = lineSpacingFactor - lineHeight;
+      pango_layout_set_spacing(pangoLayout, lineHeight * PANGO_SCALE);
     }
+    bool virtualized = Virtualized();
     if (useMarkup) {
       pango_layout_set_markup(pangoLayout, text.c_str(), -1);
-    } else {
+    } else if (!virtualized) {
       pango_layout_set_text(pangoLayout, text.c_str(), -1);
     }
     pango_layout_set_alignment(pangoLayout, textAlignment);
@@ -171,67 +656,76 @@ struct RenderData {
     pango_font_description_set_absolute_size(fontDescription, scaledFontSize);
     pango_layout_set_justify(pangoLayout, justify);
     pango_layout_set_font_description(pangoLayout, fontDescription);
-    pango_context_set_base_dir(pangoContext, dir);
     pango_layout_set_auto_dir(pangoLayout, autoDir);
 
     int scaledTextBoxWidth =
-        (int)((float)tbw * PANGO_SCALE * resolutionMultiplier);
+        (int)((float)textBoxWidth * PANGO_SCALE * resolutionMultiplier);
 
     int scaledTextBoxHeight =
-        (int)((float)tbh * PANGO_SCALE * resolutionMultiplier);
-
-    // If automatic padding is enabled, calculate the padding
-    if (automaticPadding) {
-      // Here we set the width and height to the full size available, to
-      // calculate the padding required for any overhanging characters.
-      // NOTE: By adding any padding we calculate here later on, the characters
-      // may move to other lines because of the wrapping settings. We won't be
-      // accounting for that.
-      pango_layout_set_width(pangoLayout, wrappingH == HorizontalWrapping::WrapH
-                                              ? scaledTextBoxWidth
-                                              : -1);
-      pango_layout_set_height(
-          pangoLayout,
-          wrappingV == VerticalWrapping::ExpandV ? -1 : scaledTextBoxHeight);
-
-      PangoRectangle inkRect;
-      PangoRectangle logicalRect;
-      pango_layout_get_extents(pangoLayout, &inkRect, &logicalRect);
-      // Scale to pixel values...
-      inkRect.x /= PANGO_SCALE;
-      inkRect.y /= PANGO_SCALE;
-      inkRect.width /= PANGO_SCALE;
-      inkRect.height /= PANGO_SCALE;
-      logicalRect.x /= PANGO_SCALE;
-      logicalRect.y /= PANGO_SCALE;
-      logicalRect.width /= PANGO_SCALE;
-      logicalRect.height /= PANGO_SCALE;
-      // For some fonts the characters' ink fall outside of the logical rect. We
-      // use the ink rectangle values to calculate the automatic margins
-      padding.top = (inkRect.y < 0) ? -inkRect.y : 0;
-      int inkOverflowBottom =
-          (inkRect.height + inkRect.y) - (logicalRect.height + logicalRect.y);
-      padding.bottom = inkOverflowBottom > 0 ? inkOverflowBottom : 0;
-      padding.left = (inkRect.x < 0) ? -inkRect.x : 0;
-      int inkRightOverflow =
-          (inkRect.width + inkRect.x) - (logicalRect.width + logicalRect.x);
-      padding.right = inkRightOverflow > 0 ? inkRightOverflow : 0;
+        (int)((float)textBoxHeight * PANGO_SCALE * resolutionMultiplier);
+
+    // With automatic padding, the text box must leave room for any glyphs
+    // overhanging their logical boxes. When the padding narrows the wrap
+    // width or the height limit, it has to be known before the layout, so the
+    // font's ink bounds are reserved. Otherwise the layout doesn't depend on
+    // it, and the exact overhang is measured below.
+    bool paddingShapesLayout =
+        horizontalWrapping == HorizontalWrapping::WrapH ||
+        verticalWrapping != VerticalWrapping::ExpandV || virtualized;
+    if (automaticPadding && paddingShapesLayout) {
+      FontInkBounds bounds = GetFontInkBounds(
+          fontId, pango_layout_get_context(pangoLayout), fontDescription);
+      double pixelSize = scaledFontSize / PANGO_SCALE;
+      padding.left = (int)std::ceil(bounds.left * pixelSize);
+      padding.right = (int)std::ceil(bounds.right * pixelSize);
+      padding.top = (int)std::ceil(bounds.top * pixelSize);
+      padding.bottom = (int)std::ceil(bounds.bottom * pixelSize);
+    }
+    int fieldPadding = 0;
+    if (outputMode == OutputDistanceField) {
+      fieldPadding = (int)std::ceil(distanceFieldSpread);
+      padding.left += fieldPadding;
+      padding.right += fieldPadding;
+      padding.top += fieldPadding;
+      padding.bottom += fieldPadding;
     }
     int availableWidth =
-        scaledTextBoxWidth - (padding.left + padding.right) * PANGO_SCALE;
-    // Only set the width if we want the text to wrap
-    pango_layout_set_width(pangoLayout, wrappingH == HorizontalWrapping::WrapH
-                                            ? availableWidth
-                                            : -1);
-    int availableHeight =
-        scaledTextBoxHeight - (padding.top + padding.bottom) * PANGO_SCALE;
-    pango_layout_set_height(pangoLayout, wrappingV == VerticalWrapping::ExpandV
-                                             ? -1
-                                             : availableHeight);
+        applyPaddedBox(scaledTextBoxWidth, scaledTextBoxHeight);
+    if (virtualized) {
+      layoutWindow(metrics,
+                   horizontalWrapping == HorizontalWrapping::WrapH
+                       ? availableWidth
+                       : -1);
+    }
 
     PangoRectangle inkRect;
     PangoRectangle logicalRect;
     pango_layout_get_extents(pangoLayout, &inkRect, &logicalRect);
+    int passes = 1;
+    // The window's overhang changes as it scrolls, so virtualized labels keep
+    // the padding from the font's ink bounds.
+    if (automaticPadding && !virtualized) {
+      // The ink that actually overhangs. It is within the font's bounds
+      // unless fallback fonts reach further.
+      RenderPadding measured = inkOverflow(inkRect, logicalRect);
+      measured.left += fieldPadding;
+      measured.right += fieldPadding;
+      measured.top += fieldPadding;
+      measured.bottom += fieldPadding;
+      // The text keeps the wrap width it got if the overhang fits in the
+      // room reserved for it, and is only drawn with the measured padding.
+      // Fallback fonts can reach further than the font's bounds, in which
+      // case it is laid out once more in the box less the measured padding.
+      // The height limit doesn't change a layout that isn't ellipsized.
+      bool reserved = measured.left + measured.right <=
+                      padding.left + padding.right;
+      padding = measured;
+      if (horizontalWrapping == HorizontalWrapping::WrapH && !reserved) {
+        applyPaddedBox(scaledTextBoxWidth, scaledTextBoxHeight);
+        pango_layout_get_extents(pangoLayout, &inkRect, &logicalRect);
+        passes++;
+      }
+    }
 
     renderWidth =
         logicalRect.width + (padding.left + padding.right) * PANGO_SCALE;
@@ -249,25 +743,246 @@ struct RenderData {
         verticalWrapping != HQText::VerticalWrapping::ExpandV) {
       renderHeight = scaledTextBoxHeight;
     }
+    if (virtualized) {
+      // Keep the texture size as the window changes.
+      if (horizontalWrapping != HorizontalWrapping::ExpandH) {
+        renderWidth = scaledTextBoxWidth;
+      }
+      renderHeight = viewportHeight * PANGO_SCALE;
+    }
+    return passes;
   }
 
-  ~RenderData() {
-    pango_font_description_free(fontDescription);
-    if (pangoLayout != nullptr) {
-      g_object_unref(pangoLayout);
-    } else {
-      printf("Renderer.cpp line is null ( g_object_unref(pangoLayout);)");
+  // applyPaddedBox sets the layout's wrap width and height limit to the text
+  // box less the padding, and returns the width left for the text.
+  int applyPaddedBox(int scaledTextBoxWidth, int scaledTextBoxHeight) {
+    int availableWidth =
+        scaledTextBoxWidth - (padding.left + padding.right) * PANGO_SCALE;
+    // Only set the width if we want the text to wrap
+    pango_layout_set_width(pangoLayout,
+                           horizontalWrapping == HorizontalWrapping::WrapH
+                               ? availableWidth
+                               : -1);
+    int availableHeight =
+        scaledTextBoxHeight - (padding.top + padding.bottom) * PANGO_SCALE;
+    // A viewport clips the text instead of the box.
+    pango_layout_set_height(pangoLayout,
+                            verticalWrapping == VerticalWrapping::ExpandV ||
+                                    Virtualized()
+                                ? -1
+                                : availableHeight);
+    return availableWidth;
+  }
+
+  // blockRange finds the blocks overlapping the rows top to bottom of the text,
+  // in render pixels. There is always at least one.
+  void blockRange(int top, int bottom, int* first, int* end) const {
+    int count = (int)blocks.size();
+    int y = padding.top * PANGO_SCALE;
+    *first = 0;
+    while (*first < count - 1 && y + blocks[*first].height <= top * PANGO_SCALE) {
+      y += blocks[(*first)++].height;
     }
-    if (pangoContext != nullptr) {
-      g_object_unref(pangoContext);
-    } else {
-      printf("Renderer.cpp line is null ( g_object_unref(pangoContext);)");
+    *end = *first + 1;
+    y += blocks[*first].height;
+    while (*end < count && y < bottom * PANGO_SCALE) {
+      y += blocks[(*end)++].height;
     }
-    if (fontMap != nullptr) {
-      g_object_unref(fontMap);
-    } else {
-      printf("Renderer.cpp line is null ( g_object_unref(fontMap);)");
+  }
+
+  // layoutWindow lays out the blocks within a viewport height of the viewport
+  // as pangoLayout's text, which measures them, and places the window in the
+  // text. Blocks that haven't been laid out yet are estimated to wrap at
+  // wrapWidth, if it isn't -1.
+  void layoutWindow(const FontMetrics& metrics, int wrapWidth) {
+    int spacing = pango_layout_get_spacing(pangoLayout);
+    int lineHeight = metrics.height + spacing;
+    if (blocks.empty()) {
+      blockCharsPerLine = 0;
+      if (wrapWidth > 0 && metrics.approximateCharWidth > 0) {
+        blockCharsPerLine =
+            std::max(wrapWidth / metrics.approximateCharWidth, 1);
+      }
+      blockLineHeight = lineHeight;
+      blocks = SplitTextBlocks(text, 0, (int)text.size(), blockCharsPerLine,
+                               blockLineHeight);
+    }
+    // Measuring the window corrects the estimates, which can move other
+    // blocks into the viewport, so try again a few times.
+    for (int attempt = 0; attempt < 4; ++attempt) {
+      int first, end;
+      if (attempt > 0) {
+        blockRange(viewportScrollY, viewportScrollY + viewportHeight, &first,
+                   &end);
+        if (first >= windowFirstBlock && end <= windowEndBlock) {
+          break;
+        }
+      }
+      blockRange(viewportScrollY - viewportHeight,
+                 viewportScrollY + 2 * viewportHeight, &first, &end);
+      windowFirstBlock = first;
+      windowEndBlock = end;
+      const TextBlock& last = blocks[end - 1];
+      int windowStart = blocks[first].start;
+      pango_layout_set_text(pangoLayout, text.c_str() + windowStart,
+                            last.start + last.length - windowStart);
+
+      PangoRectangle logicalRect;
+      pango_layout_get_extents(pangoLayout, nullptr, &logicalRect);
+      int blockTop = 0;
+      int blockLine = 0;
+      for (int b = first; b < end; ++b) {
+        int nextTop = logicalRect.height;
+        int nextLine = pango_layout_get_line_count(pangoLayout);
+        if (b + 1 < end) {
+          int index = blocks[b + 1].start - windowStart;
+          PangoRectangle pos;
+          pango_layout_index_to_pos(pangoLayout, index, &pos);
+          nextTop = pos.y;
+          int x;
+          pango_layout_index_to_line_x(pangoLayout, index, FALSE, &nextLine,
+                                       &x);
+        } else if (b + 1 < (int)blocks.size()) {
+          nextTop += spacing;
+        }
+        blocks[b].height = nextTop - blockTop;
+        blocks[b].lines = nextLine - blockLine;
+        blocks[b].measured = true;
+        blockTop = nextTop;
+        blockLine = nextLine;
+      }
+    }
+    windowTop = 0;
+    for (int b = 0; b < windowFirstBlock; ++b) {
+      windowTop += blocks[b].height;
+    }
+  }
+
+  // inkOverflow returns how far the ink of a layout reaches outside its
+  // logical rect, in pixels. For some fonts the characters' ink falls outside
+  // of the logical rect.
+  static RenderPadding inkOverflow(PangoRectangle inkRect,
+                                   PangoRectangle logicalRect) {
+    // Scale to pixel values...
+    inkRect.x /= PANGO_SCALE;
+    inkRect.y /= PANGO_SCALE;
+    inkRect.width /= PANGO_SCALE;
+    inkRect.height /= PANGO_SCALE;
+    logicalRect.x /= PANGO_SCALE;
+    logicalRect.y /= PANGO_SCALE;
+    logicalRect.width /= PANGO_SCALE;
+    logicalRect.height /= PANGO_SCALE;
+    RenderPadding overflow = {};
+    overflow.top = (inkRect.y < 0) ? -inkRect.y : 0;
+    int inkOverflowBottom =
+        (inkRect.height + inkRect.y) - (logicalRect.height + logicalRect.y);
+    overflow.bottom = inkOverflowBottom > 0 ? inkOverflowBottom : 0;
+    overflow.left = (inkRect.x < 0) ? -inkRect.x : 0;
+    int inkRightOverflow =
+        (inkRect.width + inkRect.x) - (logicalRect.width + logicalRect.x);
+    overflow.right = inkRightOverflow > 0 ? inkRightOverflow : 0;
+    return overflow;
+  }
+
+  // hasColorAttributes reports whether any run of the layout is drawn with a
+  // colour of its own.
+  bool hasColorAttributes() {
+    bool found = false;
+    PangoLayoutIter* it = pango_layout_get_iter(pangoLayout);
+    do {
+      PangoLayoutRun* run = pango_layout_iter_get_run_readonly(it);
+      if (run == nullptr) {
+        continue;
+      }
+      for (GSList* l = run->item->analysis.extra_attrs; l != nullptr;
+           l = l->next) {
+        switch (static_cast<PangoAttribute*>(l->data)->klass->type) {
+          case PANGO_ATTR_FOREGROUND:
+          case PANGO_ATTR_BACKGROUND:
+          case PANGO_ATTR_UNDERLINE_COLOR:
+          case PANGO_ATTR_STRIKETHROUGH_COLOR:
+          case PANGO_ATTR_FOREGROUND_ALPHA:
+          case PANGO_ATTR_BACKGROUND_ALPHA:
+            found = true;
+            break;
+          default:
+            break;
+        }
+      }
+    } while (!found && pango_layout_iter_next_run(it));
+    pango_layout_iter_free(it);
+    return found;
+  }
+
+  // hasColorFont reports whether any run of the layout is drawn with a font
+  // that has colour glyphs, which only keep their alpha in Alpha8.
+  bool hasColorFont() {
+    bool found = false;
+    PangoFont* checked = nullptr;
+    PangoLayoutIter* it = pango_layout_get_iter(pangoLayout);
+    do {
+      PangoLayoutRun* run = pango_layout_iter_get_run_readonly(it);
+      if (run == nullptr || run->item->analysis.font == checked) {
+        continue;
+      }
+      checked = run->item->analysis.font;
+      hb_face_t* face = hb_font_get_face(pango_font_get_hb_font(checked));
+      found = hb_ot_color_has_layers(face) || hb_ot_color_has_png(face) ||
+              hb_ot_color_has_svg(face);
+    } while (!found && pango_layout_iter_next_run(it));
+    pango_layout_iter_free(it);
+    return found;
+  }
+
+  TextInfo calculateTextInfo() {
+    PangoRectangle inkRect;
+    PangoRectangle logicalRect;
+    pango_layout_get_extents(pangoLayout, &inkRect, &logicalRect);
+    PangoLayoutLine* line;
+    line = pango_layout_get_line(pangoLayout, 0);
+    PangoDirection direction = dir;
+    if (autoDir && line && line->layout != NULL) {
+      direction = (PangoDirection)line->resolved_dir;
+    }
+
+    int lineCount = pango_layout_get_line_count(pangoLayout);
+    int characterCount = pango_layout_get_character_count(pangoLayout);
+    FontMetrics metrics = GetFontMetrics(
+        fontId, pango_layout_get_context(pangoLayout), fontDescription);
+    int ascent = metrics.ascent / PANGO_SCALE;
+    int descent = metrics.descent / PANGO_SCALE;
+    int lineHeight = metrics.height / PANGO_SCALE;
+
+    TextInfo info(RenderWidthPixels(), RenderHeightPixels(),
+                  logicalRect.width / PANGO_SCALE,
+                  logicalRect.height / PANGO_SCALE,
+                  inkRect.width / PANGO_SCALE, inkRect.height / PANGO_SCALE,
+                  direction, lineCount, characterCount, ascent, descent,
+                  lineHeight);
+    info.documentHeight = info.height;
+    if (Virtualized()) {
+      // Count the whole text rather than the window, and the line breaks
+      // between blocks, which are ASCII.
+      int documentHeight = 0;
+      info.characterCount = 0;
+      info.lineCount = 0;
+      for (int b = 0; b < (int)blocks.size(); ++b) {
+        int characters = blocks[b].characters;
+        if (b + 1 < (int)blocks.size()) {
+          characters +=
+              blocks[b + 1].start - (blocks[b].start + blocks[b].length);
+        }
+        documentHeight += blocks[b].height;
+        info.characterCount += characters;
+        info.lineCount += blocks[b].lines;
+        if (b < windowFirstBlock) {
+          info.firstCharacter += characters;
+        }
+      }
+      info.documentHeight =
+          documentHeight / PANGO_SCALE + padding.top + padding.bottom;
     }
+    return info;
   }
 };
 };      // namespace HQText
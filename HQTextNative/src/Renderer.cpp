@@ -1,8 +1,16 @@
 #include <pango/pango.h>
 #include <pango/pangocairo.h>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <tuple>
+#include <utility>
 #include <vector>
+#include "ClusterGeometry.h"
+#include "GlyphAtlas.h"
+#include "GlyphQuad.h"
 #include "RenderData.h"
 #include "Unity/IUnityInterface.h"
 #define LINE_IS_VALID(line) ((line) && (line)->layout != NULL)
@@ -71,35 +79,55 @@ layoutOffset calculateOffset(
 
 namespace HQText {
 
-extern "C" UNITY_INTERFACE_EXPORT cairo_surface_t* RenderToSurface(
-    RenderData* r,
-    int surfaceWidth,
-    int surfaceHeight,
-    bool fillBackground) {
-    cairo_surface_t* surface = cairo_image_surface_create(
-      CAIRO_FORMAT_ARGB32, surfaceWidth, surfaceHeight);
-  cairo_t* cr = cairo_create(surface);
- 
+// layoutOffsetFor returns where the label's layout is drawn on the surface. A
+// viewport scrolls the laid out window instead of aligning it.
+static layoutOffset layoutOffsetFor(RenderData* r,
+                                    int surfaceWidth,
+                                    int surfaceHeight) {
+  layoutOffset offset =
+      calculateOffset(r->pangoLayout, surfaceWidth, surfaceHeight,
+                      r->textAlignment, r->verticalAlignment, r->padding);
+  if (r->Virtualized()) {
+    offset.y = r->WindowOffsetY();
+  }
+  return offset;
+}
+
+TextureRect WatermarkBand(RenderData* r, int surfaceWidth, int surfaceHeight) {
+  // The watermark is centred on the surface, and its font size bounds its
+  // height on either side of the centre.
+  double fontSize = r->fontSize * 0.25;
+  int y0 = std::max((int)std::floor(surfaceHeight / 2 - fontSize) - 2, 0);
+  int y1 = std::min((int)std::ceil(surfaceHeight / 2 + fontSize) + 2,
+                    surfaceHeight);
+  return TextureRect{0, y0, surfaceWidth, std::max(y1 - y0, 0)};
+}
+
+// drawLayout clears the target and draws the render data's layout into it.
+static void drawLayout(cairo_t* cr,
+                       RenderData* r,
+                       int surfaceWidth,
+                       int surfaceHeight,
+                       bool fillBackground,
+                       bool updateLayout = true) {
+  // The target may hold a previous frame, so replace rather than blend.
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
   if (fillBackground) {
     cairo_set_source_rgba(cr, 1, 1, 1, 1);
   } else {
     cairo_set_source_rgba(cr, 0, 0, 0, 0);
   }
   cairo_paint(cr);
+  cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+  // Alpha only targets store the coverage, and the colour is applied later.
+  bool alphaOnly =
+      cairo_surface_get_content(cairo_get_target(cr)) == CAIRO_CONTENT_ALPHA;
 
-  //cairo_scale(cr, 1, -1);
-  //cairo_translate(cr, 0, -surfaceHeight); // replace SURFACE_HEIGHT
-  /*
-  cairo_matrix_t x_reflection_matrix;
-  cairo_matrix_init_identity(&x_reflection_matrix); // could not find a oneliner
-    x_reflection_matrix.yy = -1.0;
-  cairo_set_matrix(cr, &x_reflection_matrix);
-  // This would result in your drawing being done on top of the destination 
-  // surface, so we translate the surface down the full height
-  
-  */
-
- 
+  // NOTE: The image is not flipped for Unity here with a cairo_scale(cr, 1, -1)
+  // transform. pango_cairo_update_layout copies the transform into the Pango
+  // context, which is shared between labels, and any non-identity matrix marks
+  // the context as changed, forcing every layout using it to be redone. The
+  // flip is done by the pixel conversion pass instead.
 
   // Draw TRIAL VERSION text
   
@@ -111,28 +139,93 @@ extern "C" UNITY_INTERFACE_EXPORT cairo_surface_t* RenderToSurface(
       cairo_text_extents(cr, "HQTEXT TRIAL VERSION", &extents);
 
       cairo_move_to(cr, (surfaceWidth / 2) - (extents.width / 2), (surfaceHeight / 2) + (extents.height / 2));
-      cairo_set_source_rgba(cr, 0.5, 0.0, 0.0, 0.5);
+      if (alphaOnly) {
+        cairo_set_source_rgba(cr, 0.0, 0.0, 0.0, 0.5);
+      } else {
+        cairo_set_source_rgba(cr, 0.5, 0.0, 0.0, 0.5);
+      }
 
       cairo_show_text(cr, "HQTEXT TRIAL VERSION");
   }
 
-  pango_cairo_update_layout(cr, r->pangoLayout);
-  auto offset =
-      calculateOffset(r->pangoLayout, surfaceWidth, surfaceHeight,
-                      r->textAlignment, r->verticalAlignment, r->padding);
+  if (updateLayout) {
+    pango_cairo_update_layout(cr, r->pangoLayout);
+  }
+  auto offset = layoutOffsetFor(r, surfaceWidth, surfaceHeight);
 
   // TODO: Factor in font ascent and line height into the the calculations.
   // position of the topMargin-left corner of the layout
   cairo_move_to(cr, offset.x, offset.y);
   auto color = r->fontColor;
-  cairo_set_source_rgba(cr, color.r, color.g, color.b, color.a);    // not premultiplied alpha
+  if (alphaOnly) {
+    cairo_set_source_rgba(cr, 0, 0, 0, 1);
+  } else {
+    cairo_set_source_rgba(cr, color.r, color.g, color.b, color.a);    // not premultiplied alpha
+  }
   pango_cairo_show_layout(cr, r->pangoLayout);  // draw layout
+}
 
+extern "C" UNITY_INTERFACE_EXPORT cairo_surface_t* RenderToSurface(
+    RenderData* r,
+    int surfaceWidth,
+    int surfaceHeight,
+    bool fillBackground) {
+  cairo_surface_t* surface = cairo_image_surface_create(
+      CAIRO_FORMAT_ARGB32, surfaceWidth, surfaceHeight);
+  cairo_t* cr = cairo_create(surface);
+  drawLayout(cr, r, surfaceWidth, surfaceHeight, fillBackground);
   cairo_destroy(cr);
-
   return surface;
 }
 
+cairo_surface_t* RecordLayout(RenderData* r,
+                              int surfaceWidth,
+                              int surfaceHeight,
+                              bool alphaOnly) {
+  cairo_rectangle_t extents = {0, 0, (double)surfaceWidth,
+                               (double)surfaceHeight};
+  cairo_surface_t* recording = cairo_recording_surface_create(
+      alphaOnly ? CAIRO_CONTENT_ALPHA : CAIRO_CONTENT_COLOR_ALPHA, &extents);
+  // A recording surface has other font options than the image surfaces the
+  // layout is drawn to, and pango_cairo_update_layout would copy them into
+  // the shared context (see drawLayout). Take the context settings and the
+  // watermark's font options from an image surface instead, so the replay
+  // draws the same pixels as drawing directly.
+  cairo_surface_t* image = cairo_image_surface_create(CAIRO_FORMAT_A8, 1, 1);
+  cairo_t* imageCr = cairo_create(image);
+  pango_cairo_update_layout(imageCr, r->pangoLayout);
+  cairo_font_options_t* options = cairo_font_options_create();
+  cairo_surface_get_font_options(image, options);
+  cairo_destroy(imageCr);
+  cairo_surface_destroy(image);
+
+  cairo_t* cr = cairo_create(recording);
+  cairo_set_font_options(cr, options);
+  cairo_font_options_destroy(options);
+  drawLayout(cr, r, surfaceWidth, surfaceHeight, false, false);
+  cairo_destroy(cr);
+  return recording;
+}
+
+void ReplayRegionToBuffer(cairo_surface_t* recording,
+                          unsigned char* data,
+                          int stride,
+                          TextureRect region,
+                          cairo_format_t format) {
+  cairo_surface_t* surface = cairo_image_surface_create_for_data(
+      data, format, region.width, region.height, stride);
+  // Whole pixel offsets draw the same pixels as a full replay.
+  cairo_surface_set_device_offset(surface, -region.x, -region.y);
+  cairo_t* cr = cairo_create(surface);
+  // The recording covers the region, so it replaces what the buffer held.
+  cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_surface(cr, recording, 0, 0);
+  cairo_paint(cr);
+  cairo_destroy(cr);
+  cairo_surface_flush(surface);
+  cairo_surface_destroy(surface);
+}
+
 extern "C" UNITY_INTERFACE_EXPORT void WriteToPNG(char* filepath,
                                                   cairo_surface_t* surface) {
   cairo_surface_write_to_png(surface, filepath);
@@ -143,110 +236,388 @@ extern "C" UNITY_INTERFACE_EXPORT void ReleaseSurface(
   cairo_surface_destroy(surface);
 }
 
-struct lineRange {
-  int start = -1;
-  int end = -1;
-};
+// runColor returns the foreground colour a run was given with markup, or
+// color if it has none.
+static Color runColor(PangoLayoutRun* run, Color color) {
+  for (GSList* l = run->item->analysis.extra_attrs; l != nullptr;
+       l = l->next) {
+    auto attr = static_cast<PangoAttribute*>(l->data);
+    if (attr->klass->type == PANGO_ATTR_FOREGROUND) {
+      PangoColor c = reinterpret_cast<PangoAttrColor*>(attr)->color;
+      color.r = c.red / 65535.0;
+      color.g = c.green / 65535.0;
+      color.b = c.blue / 65535.0;
+    } else if (attr->klass->type == PANGO_ATTR_FOREGROUND_ALPHA) {
+      color.a = reinterpret_cast<PangoAttrInt*>(attr)->value / 65535.0;
+    }
+  }
+  return color;
+}
 
-std::vector<lineRange> generateClusterToLineMapping(PangoLayout* l) {
-  std::vector<PangoRectangle> lineRects;
-  std::vector<lineRange> lineRanges;
+static uint64_t hashMix(uint64_t hash, uint64_t value) {
+  hash = (hash ^ value) * 0x100000001B3ull;
+  return hash ^ (hash >> 29);
+}
 
-  PangoLayoutIter* lineIt = pango_layout_get_iter(l);
-  do {
-    PangoRectangle lineRect;
-    pango_layout_iter_get_line_extents(lineIt, nullptr, &lineRect);
-    lineRects.push_back(lineRect);
-    lineRanges.push_back({});
-  } while (pango_layout_iter_next_line(lineIt));
-  pango_layout_iter_free(lineIt);
-
-  PangoLayoutIter* clusterIt = pango_layout_get_iter(l);
-  int clusterIndex = 0;
-  int lineIndex = 0;
-  do {
-    PangoRectangle clusterRect;
-    pango_layout_iter_get_cluster_extents(clusterIt, nullptr, &clusterRect);
-    // Assume that cluster won't be in previous lines
-    for (int li = lineIndex; li < lineRects.size(); ++li) {
-      auto lineRect = lineRects[li];
-      if (clusterRect.y >= lineRect.y &&
-          clusterRect.y + clusterRect.height <= lineRect.y + lineRect.height) {
-        if (lineRanges[li].start < 0) {
-          lineRanges[li].start = clusterIndex;
-        }
-        if (clusterIndex > lineRanges[li].end) {
-          lineRanges[li].end = clusterIndex;
-        }
-        break;
-      }
-    }
-    clusterIndex++;
-  } while (pango_layout_iter_next_cluster(clusterIt));
-  pango_layout_iter_free(clusterIt);
-  return lineRanges;
+static uint64_t hashDouble(uint64_t hash, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return hashMix(hash, bits);
 }
 
-// GetRenderedClusterRects calculates the cluster int rectangles and populates
-// rects with the information. The value returned is the actual number of
-// rectangles populated.
-extern "C" UNITY_INTERFACE_EXPORT int GetRenderedClusterRects(
-    RenderData* renderData,
-    int surfaceWidth,
-    int surfaceHeight,
-    PangoRectangle* rects,
-    int count) {
-  // Initialize the rectangles
-  for (int c = 0; c < count; c++) {
-    rects[c] = PangoRectangle{0, 0, 0, 0};
+// runStyleHash hashes the attributes pango_cairo draws a run with that don't
+// change its glyphs: its colours and decorations.
+static uint64_t runStyleHash(PangoLayoutRun* run, Color color) {
+  Color c = runColor(run, color);
+  uint64_t hash = 0xCBF29CE484222325ull;
+  hash = hashDouble(hash, c.r);
+  hash = hashDouble(hash, c.g);
+  hash = hashDouble(hash, c.b);
+  hash = hashDouble(hash, c.a);
+  for (GSList* l = run->item->analysis.extra_attrs; l != nullptr;
+       l = l->next) {
+    auto attr = static_cast<PangoAttribute*>(l->data);
+    PangoAttrType type = attr->klass->type;
+    hash = hashMix(hash, (uint64_t)type);
+    if (type == PANGO_ATTR_BACKGROUND || type == PANGO_ATTR_UNDERLINE_COLOR ||
+        type == PANGO_ATTR_STRIKETHROUGH_COLOR) {
+      PangoColor pc = reinterpret_cast<PangoAttrColor*>(attr)->color;
+      hash = hashMix(hash, ((uint64_t)pc.red << 32) |
+                               ((uint64_t)pc.green << 16) | pc.blue);
+    } else if (type == PANGO_ATTR_UNDERLINE ||
+               type == PANGO_ATTR_STRIKETHROUGH ||
+               type == PANGO_ATTR_BACKGROUND_ALPHA ||
+               type == PANGO_ATTR_RISE) {
+      int value = reinterpret_cast<PangoAttrInt*>(attr)->value;
+      hash = hashMix(hash, (uint64_t)(unsigned int)value);
+    }
   }
+  return hash;
+}
 
-  int characterCount =
-      pango_layout_get_character_count(renderData->pangoLayout);
-  if (characterCount == 0) {
-    return 0;
+// clusterGlyphHashes hashes the glyphs of each cluster in the run, keyed and
+// sorted by the cluster's byte offset in the run's item.
+static void clusterGlyphHashes(PangoLayoutRun* run,
+                               std::vector<std::pair<int, uint64_t>>* hashes) {
+  hashes->clear();
+  PangoGlyphString* glyphs = run->glyphs;
+  for (int g = 0; g < glyphs->num_glyphs; ++g) {
+    int cluster = glyphs->log_clusters[g];
+    if (hashes->empty() || hashes->back().first != cluster) {
+      hashes->push_back({cluster, 0xCBF29CE484222325ull});
+    }
+    const PangoGlyphInfo& info = glyphs->glyphs[g];
+    uint64_t& hash = hashes->back().second;
+    hash = hashMix(hash, info.glyph);
+    uint64_t xOffset = (unsigned int)info.geometry.x_offset;
+    hash = hashMix(hash, (xOffset << 32) | (unsigned int)info.geometry.y_offset);
+    hash = hashMix(hash, (uint64_t)(unsigned int)info.geometry.width);
   }
+  // Right to left runs list their glyphs in visual order.
+  std::sort(hashes->begin(), hashes->end());
+}
 
-  auto offset =
-      calculateOffset(renderData->pangoLayout, surfaceWidth, surfaceHeight,
-                      renderData->textAlignment, renderData->verticalAlignment,
-                      renderData->padding);
-
-  PangoLayoutIter* it = pango_layout_get_iter(renderData->pangoLayout);
-  std::vector<PangoRectangle> clusterRects;
+void StampClusters(RenderData* r,
+                   int surfaceWidth,
+                   int surfaceHeight,
+                   std::vector<ClusterStamp>* stamps) {
+  stamps->clear();
+  // Everything that affects the whole surface as far as damage is concerned:
+  // the watermark depends on the font size, and distance fields on the spread.
+  uint64_t surfaceHash = hashMix(0, (uint64_t)r->fontSize);
+  surfaceHash = hashMix(surfaceHash, (uint64_t)r->outputMode);
+  surfaceHash = hashDouble(surfaceHash, r->distanceFieldSpread);
+  stamps->push_back(ClusterStamp{0, 0, surfaceWidth * PANGO_SCALE,
+                                 surfaceHeight * PANGO_SCALE,
+                                 SurfaceStampFontKey, surfaceHash});
+
+  auto offset = layoutOffsetFor(r, surfaceWidth, surfaceHeight);
+  int offsetX = (int)std::lround(offset.x * PANGO_SCALE);
+  int offsetY = (int)std::lround(offset.y * PANGO_SCALE);
+  const int cullMargin = 4 * PANGO_SCALE;
+
+  PangoLayoutRun* currentRun = nullptr;
+  int fontKey = 0;
+  uint64_t style = 0;
+  std::vector<std::pair<int, uint64_t>> glyphHashes;
+  PangoLayoutIter* it = pango_layout_get_iter(r->pangoLayout);
   do {
-    PangoRectangle rect;
-    pango_layout_iter_get_cluster_extents(it, &rect, nullptr);
+    PangoLayoutRun* run = pango_layout_iter_get_run_readonly(it);
+    // The end of each line has no run.
+    if (run == nullptr) {
+      continue;
+    }
+    if (run != currentRun) {
+      currentRun = run;
+      fontKey = GlyphFontKey(run->item->analysis.font);
+      style = runStyleHash(run, r->fontColor);
+      clusterGlyphHashes(run, &glyphHashes);
+    }
+    int cluster = pango_layout_iter_get_index(it) - run->item->offset;
+    auto glyphHash = std::lower_bound(
+        glyphHashes.begin(), glyphHashes.end(),
+        std::pair<int, uint64_t>(cluster, 0));
+    uint64_t content = style;
+    if (glyphHash != glyphHashes.end() && glyphHash->first == cluster) {
+      content = hashMix(content, glyphHash->second);
+    }
 
-    rect.x /= PANGO_SCALE;
-    rect.y /= PANGO_SCALE;
-    rect.width /= PANGO_SCALE;
-    rect.height /= PANGO_SCALE;
-    rect.x += std::floor(offset.x);
-    rect.y += std::floor(offset.y);
+    PangoRectangle ink, logical;
+    pango_layout_iter_get_cluster_extents(it, &ink, &logical);
+    int left = logical.x, top = logical.y;
+    int right = logical.x + logical.width;
+    int bottom = logical.y + logical.height;
+    if (ink.width > 0 && ink.height > 0) {
+      left = std::min(left, ink.x);
+      top = std::min(top, ink.y);
+      right = std::max(right, ink.x + ink.width);
+      bottom = std::max(bottom, ink.y + ink.height);
+    }
+    left += offsetX;
+    right += offsetX;
+    top += offsetY;
+    bottom += offsetY;
+    // Clusters off the surface don't draw anything, like most of a long
+    // text's window.
+    if (right < -cullMargin || bottom < -cullMargin ||
+        left > surfaceWidth * PANGO_SCALE + cullMargin ||
+        top > surfaceHeight * PANGO_SCALE + cullMargin) {
+      continue;
+    }
+    stamps->push_back(ClusterStamp{left, top, right - left, bottom - top,
+                                   fontKey, content});
+  } while (pango_layout_iter_next_cluster(it));
+  pango_layout_iter_free(it);
 
-    clusterRects.push_back(rect);
-  } while (pango_layout_iter_next_cluster(it) && clusterRects.size() <= count);
+  std::sort(stamps->begin(), stamps->end());
+}
 
+// appendLayoutQuads adds a quad for every inked glyph of the layout drawn at
+// (offsetX, offsetY), continuing from count. It returns the new count, which
+// keeps growing past capacity so the caller learns the size it needs.
+static int appendLayoutQuads(PangoLayout* layout,
+                             double offsetX,
+                             double offsetY,
+                             Color color,
+                             GlyphQuad* quads,
+                             int capacity,
+                             int count) {
+  const float pageSize = (float)GlyphAtlasPageSize;
+  PangoLayoutIter* it = pango_layout_get_iter(layout);
+  do {
+    PangoLayoutRun* run = pango_layout_iter_get_run_readonly(it);
+    // The end of each line has no run.
+    if (run == nullptr) {
+      continue;
+    }
+    PangoFont* font = run->item->analysis.font;
+    int fontKey = GlyphFontKey(font);
+    Color c = runColor(run, color);
+    PangoRectangle runRect;
+    pango_layout_iter_get_run_extents(it, nullptr, &runRect);
+    int baseline = pango_layout_iter_get_baseline(it);
+
+    // Pango has already positioned combining marks and ligature components
+    // with the glyph offsets.
+    int x = runRect.x;
+    for (int g = 0; g < run->glyphs->num_glyphs; ++g) {
+      const PangoGlyphInfo& info = run->glyphs->glyphs[g];
+      int advance = info.geometry.width;
+      if (info.glyph == PANGO_GLYPH_EMPTY) {
+        x += advance;
+        continue;
+      }
+      double originX =
+          offsetX + (double)(x + info.geometry.x_offset) / PANGO_SCALE;
+      double originY =
+          offsetY + (double)(baseline + info.geometry.y_offset) / PANGO_SCALE;
+      x += advance;
+
+      int pixelX = (int)std::floor(originX);
+      int subpixel =
+          (int)std::lround((originX - pixelX) * GlyphSubpixelSteps);
+      if (subpixel == GlyphSubpixelSteps) {
+        pixelX++;
+        subpixel = 0;
+      }
+      int pixelY = (int)std::lround(originY);
+
+      GlyphAtlasEntry entry;
+      if (!FindOrAddGlyph(font, fontKey, info.glyph, subpixel, &entry)) {
+        continue;
+      }
+      if (count < capacity) {
+        GlyphQuad& q = quads[count];
+        q.x = (float)(pixelX + entry.bearingX);
+        q.y = (float)(pixelY + entry.bearingY);
+        q.width = (float)entry.width;
+        q.height = (float)entry.height;
+        q.u0 = entry.x / pageSize;
+        q.v0 = entry.y / pageSize;
+        q.u1 = (entry.x + entry.width) / pageSize;
+        q.v1 = (entry.y + entry.height) / pageSize;
+        q.r = (float)c.r;
+        q.g = (float)c.g;
+        q.b = (float)c.b;
+        q.a = (float)c.a;
+        q.page = entry.page;
+      }
+      count++;
+    }
+  } while (pango_layout_iter_next_run(it));
   pango_layout_iter_free(it);
+  return count;
+}
 
-  // We need to swap the position of characters in each line if the
-  // direction
-  // is right to left, to have them in the correct order from begin to end.
-  if ((PangoDirection)pango_layout_get_line_readonly(renderData->pangoLayout, 0)
-          ->resolved_dir == PANGO_DIRECTION_RTL) {
-    auto clusterLineMap = generateClusterToLineMapping(renderData->pangoLayout);
-    for (auto lineRange : clusterLineMap) {
-      int half = (lineRange.end - lineRange.start + 1) / 2;
-      // Flip positions of the characters in the line
-      for (int ci = 0; ci < half; ci++) {
-        std::swap(clusterRects[lineRange.start + ci],
-                  clusterRects[lineRange.end - ci]);
+int BuildGlyphQuads(RenderData* r,
+                    int surfaceWidth,
+                    int surfaceHeight,
+                    GlyphQuad* quads,
+                    int capacity) {
+  int count = 0;
+
+  // The TRIAL VERSION text, as drawn on textures.
+  {
+    PangoLayout* trial =
+        pango_layout_new(pango_layout_get_context(r->pangoLayout));
+    PangoFontDescription* desc =
+        pango_font_description_from_string("Monospace Bold");
+    pango_font_description_set_absolute_size(desc,
+                                             r->fontSize * 0.25 * PANGO_SCALE);
+    pango_layout_set_font_description(trial, desc);
+    pango_layout_set_text(trial, "HQTEXT TRIAL VERSION", -1);
+    PangoRectangle ink;
+    pango_layout_get_pixel_extents(trial, &ink, nullptr);
+    count = appendLayoutQuads(
+        trial, surfaceWidth / 2.0 - ink.x - ink.width / 2.0,
+        surfaceHeight / 2.0 - ink.y - ink.height / 2.0,
+        Color(0.5, 0.0, 0.0, 0.5), quads, capacity, count);
+    pango_font_description_free(desc);
+    g_object_unref(trial);
+  }
+
+  auto offset = layoutOffsetFor(r, surfaceWidth, surfaceHeight);
+  return appendLayoutQuads(r->pangoLayout, offset.x, offset.y, r->fontColor,
+                           quads, capacity, count);
+}
+
+// visitedCluster is a cluster as the layout iterator visits them, in visual
+// order.
+struct visitedCluster {
+  int line;
+  int byteIndex;
+  PangoRectangle ink;
+  int left;
+  int right;
+  bool rtl;
+};
+
+std::shared_ptr<const ClusterGeometry> BuildClusterGeometry(
+    RenderData* r,
+    int surfaceWidth,
+    int surfaceHeight) {
+  auto geometry = std::make_shared<ClusterGeometry>();
+  if (pango_layout_get_character_count(r->pangoLayout) == 0) {
+    return geometry;
+  }
+  auto offset = layoutOffsetFor(r, surfaceWidth, surfaceHeight);
+  int offsetX = (int)std::floor(offset.x);
+  int offsetY = (int)std::floor(offset.y);
+
+  std::vector<visitedCluster> visited;
+  GSList* lines = pango_layout_get_lines_readonly(r->pangoLayout);
+  PangoLayoutLine* currentLine = nullptr;
+  int lineIndex = -1;
+  PangoLayoutIter* it = pango_layout_get_iter(r->pangoLayout);
+  do {
+    PangoLayoutLine* line = pango_layout_iter_get_line_readonly(it);
+    if (line != currentLine) {
+      if (currentLine != nullptr) {
+        lines = lines->next;
       }
+      currentLine = line;
+      lineIndex++;
+      int top, bottom;
+      pango_layout_iter_get_line_yrange(it, &top, &bottom);
+      geometry->lineTop.push_back(top / PANGO_SCALE + offsetY);
+      geometry->lineBottom.push_back(bottom / PANGO_SCALE + offsetY);
     }
+    PangoLayoutRun* run = pango_layout_iter_get_run_readonly(it);
+    if (run == nullptr && lines != nullptr && lines->next != nullptr &&
+        !static_cast<PangoLayoutLine*>(lines->next->data)->is_paragraph_start) {
+      // The end of a wrapped line is the start of the next one, not a
+      // character of its own.
+      continue;
+    }
+    visitedCluster cluster;
+    cluster.line = lineIndex;
+    cluster.byteIndex = pango_layout_iter_get_index(it);
+    PangoRectangle logical;
+    pango_layout_iter_get_cluster_extents(it, &cluster.ink, &logical);
+    cluster.ink.x = cluster.ink.x / PANGO_SCALE + offsetX;
+    cluster.ink.y = cluster.ink.y / PANGO_SCALE + offsetY;
+    cluster.ink.width /= PANGO_SCALE;
+    cluster.ink.height /= PANGO_SCALE;
+    cluster.left = logical.x / PANGO_SCALE + offsetX;
+    cluster.right = (logical.x + logical.width) / PANGO_SCALE + offsetX;
+    cluster.rtl = run != nullptr
+                      ? (run->item->analysis.level & 1) != 0
+                      : line->resolved_dir == PANGO_DIRECTION_RTL;
+    visited.push_back(cluster);
+  } while (pango_layout_iter_next_cluster(it));
+  pango_layout_iter_free(it);
+
+  // Lines are visited one after the other, so sorting by line and text
+  // position gives the logical order without moving clusters between lines.
+  int clusterCount = (int)visited.size();
+  std::vector<int> order(clusterCount);
+  for (int v = 0; v < clusterCount; ++v) {
+    order[v] = v;
   }
-  std::copy(clusterRects.begin(), clusterRects.end(), rects);
-  return (int)clusterRects.size();  // add one to index to return amount
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return std::tie(visited[a].line, visited[a].byteIndex) <
+           std::tie(visited[b].line, visited[b].byteIndex);
+  });
+
+  geometry->inkRects.resize(clusterCount);
+  geometry->byteIndices.resize(clusterCount);
+  geometry->left.resize(clusterCount);
+  geometry->right.resize(clusterCount);
+  geometry->rtl.resize(clusterCount);
+  geometry->visualToLogical.resize(clusterCount);
+  geometry->logicalToVisual.resize(clusterCount);
+  geometry->lineFirstCluster.assign(geometry->lineTop.size(), clusterCount);
+  for (int c = clusterCount - 1; c >= 0; --c) {
+    const visitedCluster& cluster = visited[order[c]];
+    geometry->inkRects[c] = cluster.ink;
+    geometry->byteIndices[c] = cluster.byteIndex;
+    geometry->left[c] = cluster.left;
+    geometry->right[c] = cluster.right;
+    geometry->rtl[c] = cluster.rtl;
+    geometry->visualToLogical[order[c]] = c;
+    geometry->logicalToVisual[c] = order[c];
+    geometry->lineFirstCluster[cluster.line] = c;
+  }
+  // Lines without clusters start where the next line does.
+  for (int l = (int)geometry->lineFirstCluster.size() - 2; l >= 0; --l) {
+    geometry->lineFirstCluster[l] = std::min(geometry->lineFirstCluster[l],
+                                             geometry->lineFirstCluster[l + 1]);
+  }
+  return geometry;
+}
+
+// GetRenderedClusterRects calculates the cluster int rectangles and populates
+// rects with the information. The value returned is the actual number of
+// rectangles populated.
+extern "C" UNITY_INTERFACE_EXPORT int GetRenderedClusterRects(
+    RenderData* renderData,
+    int surfaceWidth,
+    int surfaceHeight,
+    PangoRectangle* rects,
+    int count) {
+  auto geometry =
+      BuildClusterGeometry(renderData, surfaceWidth, surfaceHeight);
+  return CopyClusterRects(*geometry, rects, count);
 }
 
 }  // namespace HQText
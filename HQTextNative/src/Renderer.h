@@ -3,6 +3,11 @@
 
 #include <pango/pango.h>
 #include <pango/pangocairo.h>
+#include <memory>
+#include <vector>
+#include "ClusterGeometry.h"
+#include "GlyphQuad.h"
+#include "RasterDamage.h"
 #include "RenderData.h"
 #include "Unity/IUnityInterface.h"
 
@@ -16,6 +21,51 @@ extern "C" UNITY_INTERFACE_EXPORT cairo_surface_t* RenderToSurface(
     int surfaceHeight,
     bool fillBackground);
 
+// RecordLayout records drawing the label on a surfaceWidth x surfaceHeight
+// surface. The recording holds its own references to the fonts it draws with,
+// so it can be replayed without the lane mutex, which must be held to record
+// it. An alpha only recording draws only the coverage of the text.
+cairo_surface_t* RecordLayout(RenderData* r,
+                              int surfaceWidth,
+                              int surfaceHeight,
+                              bool alphaOnly);
+
+// ReplayRegionToBuffer draws the given region of a recording into data, which
+// holds region.height rows of stride bytes in the given format. It doesn't use
+// the label's pango objects.
+void ReplayRegionToBuffer(cairo_surface_t* recording,
+                          unsigned char* data,
+                          int stride,
+                          TextureRect region,
+                          cairo_format_t format);
+
+// StampClusters records what each cluster of the layout draws at the given
+// surface size, sorted, for DamagedRegion. The lane mutex of r must be held.
+void StampClusters(RenderData* r,
+                   int surfaceWidth,
+                   int surfaceHeight,
+                   std::vector<ClusterStamp>* stamps);
+
+// BuildGlyphQuads writes up to capacity glyph quads for drawing the label from
+// the glyph atlas at the given size, adding any glyphs the atlas is missing.
+// It returns the number of quads the label needs, which may exceed capacity.
+int BuildGlyphQuads(RenderData* r,
+                    int surfaceWidth,
+                    int surfaceHeight,
+                    GlyphQuad* quads,
+                    int capacity);
+
+// BuildClusterGeometry indexes the clusters of the label's layout as drawn on
+// a surface of the given size.
+std::shared_ptr<const ClusterGeometry> BuildClusterGeometry(
+    RenderData* r,
+    int surfaceWidth,
+    int surfaceHeight);
+
+// WatermarkBand returns the rows of a surface the trial watermark may cover.
+// It doesn't move when a viewport scrolls.
+TextureRect WatermarkBand(RenderData* r, int surfaceWidth, int surfaceHeight);
+
 extern "C" UNITY_INTERFACE_EXPORT int GetRenderedClusterRects(
     HQText::RenderData* renderData,
     int surfaceWidth,
@@ -0,0 +1,117 @@
+#ifndef HQTEXT_SLOTMAP_H
+#define HQTEXT_SLOTMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace HQText {
+
+// SlotMap stores values in a dense array and hands out 32-bit handles that
+// encode a slot index and a generation. Lookups are two array accesses, and
+// handles to erased values are detected by their generation rather than
+// finding whatever was inserted into the slot later. Handles are never 0.
+//
+// Erasing moves the last value into the hole, so pointers into the map and
+// iteration order are only stable until the next Insert or Erase.
+template <typename T>
+class SlotMap {
+ public:
+  static const unsigned int indexBits = 20;
+  static const uint32_t indexMask = (1u << indexBits) - 1;
+  static const uint32_t generationMask = (1u << (32 - indexBits)) - 1;
+  // One slot index is reserved so that no handle is 0.
+  static const uint32_t maxSize = indexMask;
+
+  // Insert adds value and returns its handle, or 0 if the map is full.
+  uint32_t Insert(T value) {
+    uint32_t slotIndex;
+    if (!freeSlots.empty()) {
+      slotIndex = freeSlots.back();
+      freeSlots.pop_back();
+    } else {
+      if (slots.size() >= maxSize) {
+        return 0;
+      }
+      slotIndex = (uint32_t)slots.size();
+      slots.push_back(Slot());
+    }
+    Slot& slot = slots[slotIndex];
+    slot.denseIndex = (uint32_t)values.size();
+    values.push_back(std::move(value));
+    denseToSlot.push_back(slotIndex);
+    return makeHandle(slotIndex, slot.generation);
+  }
+
+  // Find returns the value for handle, or nullptr if it was erased.
+  T* Find(uint32_t handle) {
+    uint32_t slotIndex = (handle & indexMask) - 1;
+    if (slotIndex >= slots.size()) {
+      return nullptr;
+    }
+    const Slot& slot = slots[slotIndex];
+    if (slot.denseIndex == freeSlot ||
+        slot.generation != (handle >> indexBits)) {
+      return nullptr;
+    }
+    return &values[slot.denseIndex];
+  }
+
+  // Erase removes the value for handle, and returns false if there is none.
+  bool Erase(uint32_t handle) {
+    if (Find(handle) == nullptr) {
+      return false;
+    }
+    uint32_t slotIndex = (handle & indexMask) - 1;
+    Slot& slot = slots[slotIndex];
+    uint32_t last = (uint32_t)values.size() - 1;
+    if (slot.denseIndex != last) {
+      values[slot.denseIndex] = std::move(values[last]);
+      denseToSlot[slot.denseIndex] = denseToSlot[last];
+      slots[denseToSlot[last]].denseIndex = slot.denseIndex;
+    }
+    values.pop_back();
+    denseToSlot.pop_back();
+
+    slot.denseIndex = freeSlot;
+    // Skip generation 0 when wrapping so that handles are never 0.
+    slot.generation = (slot.generation + 1) & generationMask;
+    if (slot.generation == 0) {
+      slot.generation = 1;
+    }
+    freeSlots.push_back(slotIndex);
+    return true;
+  }
+
+  // HandleAt returns the handle of the value at position i of the iteration.
+  uint32_t HandleAt(size_t i) const {
+    uint32_t slotIndex = denseToSlot[i];
+    return makeHandle(slotIndex, slots[slotIndex].generation);
+  }
+
+  size_t Size() const { return values.size(); }
+
+  typename std::vector<T>::iterator begin() { return values.begin(); }
+  typename std::vector<T>::iterator end() { return values.end(); }
+
+ private:
+  static const uint32_t freeSlot = 0xffffffff;
+
+  struct Slot {
+    uint32_t denseIndex = freeSlot;
+    uint32_t generation = 1;
+  };
+
+  static uint32_t makeHandle(uint32_t slotIndex, uint32_t generation) {
+    return (generation << indexBits) | (slotIndex + 1);
+  }
+
+  std::vector<Slot> slots;
+  std::vector<uint32_t> freeSlots;
+  std::vector<T> values;
+  std::vector<uint32_t> denseToSlot;
+};
+
+}  // namespace HQText
+#endif  // HQTEXT_SLOTMAP_H
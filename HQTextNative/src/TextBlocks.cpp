@@ -0,0 +1,71 @@
+#include "TextBlocks.h"
+
+namespace HQText {
+
+std::vector<TextBlock> SplitTextBlocks(const std::string& text,
+                                       int start,
+                                       int end,
+                                       int charsPerLine,
+                                       int lineHeight) {
+  std::vector<TextBlock> blocks;
+  TextBlock block = {start, 0, 0, 0, 0, false};
+  int paragraphCharacters = 0;
+  for (int i = start; i <= end; ++i) {
+    bool last = i == end;
+    if (!last && text[i] != '\n') {
+      // Count the first byte of each UTF-8 sequence.
+      if ((text[i] & 0xC0) != 0x80) {
+        paragraphCharacters++;
+      }
+      continue;
+    }
+    int lines = 1;
+    if (charsPerLine > 0 && paragraphCharacters > charsPerLine) {
+      lines = (paragraphCharacters + charsPerLine - 1) / charsPerLine;
+    }
+    block.lines += lines;
+    block.characters += paragraphCharacters;
+    paragraphCharacters = 0;
+    int length = i - block.start;
+    if (last || length >= TextBlockBytes) {
+      block.length = length;
+      // Leave a carriage return of a CRLF break out of the block, so it
+      // doesn't end in an empty paragraph.
+      if (block.length > 0 && text[block.start + block.length - 1] == '\r') {
+        block.length--;
+        block.characters--;
+      }
+      block.height = block.lines * lineHeight;
+      blocks.push_back(block);
+      block = {i + 1, 0, 0, 0, 0, false};
+    } else {
+      // The line break is part of the block.
+      block.characters++;
+    }
+  }
+  return blocks;
+}
+
+size_t NextParagraphStart(const std::string& text, size_t from, bool markup) {
+  int depth = 0;
+  for (size_t i = from; i < text.size(); ++i) {
+    if (markup && text[i] == '<') {
+      size_t tagEnd = text.find('>', i);
+      if (tagEnd == std::string::npos) {
+        break;
+      }
+      if (text[i + 1] == '/') {
+        depth--;
+      } else if (text[tagEnd - 1] != '/') {
+        // Not a self closing tag like <br/>.
+        depth++;
+      }
+      i = tagEnd;
+    } else if (text[i] == '\n' && depth <= 0) {
+      return i + 1;
+    }
+  }
+  return text.size();
+}
+
+}  // namespace HQText
@@ -0,0 +1,43 @@
+#ifndef HQTEXT_TEXTBLOCKS_H
+#define HQTEXT_TEXTBLOCKS_H
+
+#include <string>
+#include <vector>
+
+namespace HQText {
+
+// TextBlock is a run of whole paragraphs of a long text, which is laid out
+// only while it is near the viewport.
+struct TextBlock {
+  // The byte range of the block, without the line break that ends it.
+  int start;
+  int length;
+  int characters;
+  // The block's height in pango units, including the line spacing to the next
+  // block, and its line count. Both are estimated until the block is laid out.
+  int height;
+  int lines;
+  bool measured;
+};
+
+// SplitTextBlocks splits the bytes start to end of text, which must start a
+// paragraph, into blocks of whole paragraphs of at least TextBlockBytes bytes.
+// Each paragraph is estimated to take lineHeight pango units per line and to
+// wrap every charsPerLine characters, or not at all if charsPerLine isn't
+// positive. There is always at least one block.
+std::vector<TextBlock> SplitTextBlocks(const std::string& text,
+                                       int start,
+                                       int end,
+                                       int charsPerLine,
+                                       int lineHeight);
+
+const int TextBlockBytes = 2048;
+
+// NextParagraphStart returns the byte after the line break that ends the
+// paragraph starting at from, or the end of text for the last paragraph. In
+// markup, line breaks inside a tag or an element that is still open don't end
+// a paragraph, so the text can be cut there without breaking the markup.
+size_t NextParagraphStart(const std::string& text, size_t from, bool markup);
+
+}  // namespace HQText
+#endif  // HQTEXT_TEXTBLOCKS_H
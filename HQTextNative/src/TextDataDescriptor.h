@@ -0,0 +1,54 @@
+#ifndef HQTEXT_TEXTDATADESCRIPTOR_H
+#define HQTEXT_TEXTDATADESCRIPTOR_H
+
+#include <pango/pango.h>
+#include <cstddef>
+#include "Color.h"
+#include "HorizontalWrapping.h"
+#include "VerticalAlignment.h"
+#include "VerticalWrapping.h"
+
+namespace HQText {
+
+// TextDataDescriptor holds the SetTextDataWithFontId arguments for one label
+// in a SetTextDataBatch call. Callers set size to the sizeof the struct they
+// were built against. New fields are only ever appended, and fields missing
+// from an older caller's struct read as zero.
+struct TextDataDescriptor {
+  unsigned int size;
+  unsigned int index;
+  const char* text;
+  int fontId;
+  int fontSize;
+  int textBoxWidth;
+  int textBoxHeight;
+  Color color;
+  PangoAlignment textAlignment;
+  float lineSpacing;
+  gboolean justify;
+  gboolean autoDir;
+  PangoDirection dir;
+  VerticalAlignment va;
+  HorizontalWrapping wrappingH;
+  VerticalWrapping wrappingV;
+  gboolean useMarkup;
+  float resolutionMultiplier;
+  gboolean automaticPadding;
+  int paddingLeft;
+  int paddingRight;
+  int paddingTop;
+  int paddingBottom;
+  // The label's character rects go to rectCount entries of the batch's rects
+  // array, starting at rectOffset. A rectCount of 0 skips them.
+  int rectOffset;
+  int rectCount;
+};
+
+// The size of the first version of the struct, which ends with rectCount.
+// Smaller descriptors are rejected. This stays fixed as fields are appended,
+// so callers built against the first version keep working.
+const unsigned int TextDataDescriptorMinSize =
+    offsetof(TextDataDescriptor, rectCount) + sizeof(int);
+
+}  // namespace HQText
+#endif  // HQTEXT_TEXTDATADESCRIPTOR_H
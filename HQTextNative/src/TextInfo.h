@@ -1,4 +1,5 @@
 #include <pango/pango.h>
+#include "RasterFormat.h"
 #ifndef HQTEXTTEST_TEXTINFO_H
 #define HQTEXTTEST_TEXTINFO_H
 namespace HQText {
@@ -15,6 +16,40 @@ struct TextInfo {
   int ascent;
   int descent;
   int lineHeight;
+  // Whether the texture holds premultiplied alpha colours.
+  gboolean premultipliedAlpha = false;
+  // The format the label's texture was last written in, which follows the
+  // format of the texture being updated. Before the first write it is the
+  // preferred format.
+  RasterFormat textureFormat = RasterRGBA32;
+  // The height of the whole text including the padding, in render pixels,
+  // which only differs from height when a viewport shows part of it.
+  int documentHeight = 0;
+  // The first character of the laid out window of a label with a viewport.
+  // Character rects and clusters start from it.
+  int firstCharacter = 0;
+  // The texture format the label is best rasterized in. Single colour labels
+  // can use Alpha8.
+  RasterFormat preferredTextureFormat = RasterRGBA32;
+  // How many times pango laid the text out for the current layout. Automatic
+  // padding lays wrapped text out again only when fallback fonts overhang
+  // further than the font's bounds.
+  int layoutPasses = 0;
+
+  TextInfo() {
+    width = 0;
+    height = 0;
+    widthLogical = 0;
+    heightLogical = 0;
+    widthInk = 0;
+    heightInk = 0;
+    direction = PANGO_DIRECTION_NEUTRAL;
+    lineCount = 0;
+    characterCount = 0;
+    ascent = 0;
+    descent = 0;
+    lineHeight = 0;
+  }
 
   TextInfo(int w,
            int h,
@@ -0,0 +1,125 @@
+#include "TextSizeCache.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace HQText {
+
+struct TextSizeKeyHash {
+  size_t operator()(const TextSizeKey& key) const { return key.hash; }
+};
+
+struct TextSizeEntry {
+  TextSize size;
+  // Position in lruOrder.
+  std::list<const TextSizeKey*>::iterator order;
+};
+
+static std::unordered_map<TextSizeKey, TextSizeEntry, TextSizeKeyHash>
+    entries = {};
+// Keys of entries, most recently used first. They point into entries, whose
+// keys don't move.
+static std::list<const TextSizeKey*> lruOrder = {};
+static TextSizeCacheStats cacheStats = {0, 0, 0, 0, 1024};
+static std::mutex textSizeCacheMutex;
+// Incremented by ClearTextSizeCache with the mutex held.
+static std::atomic<unsigned int> cacheGeneration(0);
+
+static size_t hashCombine(size_t h, size_t value) {
+  return h ^ (value + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2));
+}
+
+TextSizeKey MakeTextSizeKey(const char* text,
+                            int fontId,
+                            int fontSize,
+                            float lineSpacing,
+                            bool useMarkup,
+                            _cairo_font_type backend) {
+  TextSizeKey key = {text != nullptr ? text : "",
+                     fontId,
+                     fontSize,
+                     lineSpacing,
+                     useMarkup,
+                     backend,
+                     0,
+                     cacheGeneration.load()};
+  uint32_t spacingBits;
+  memcpy(&spacingBits, &lineSpacing, sizeof(spacingBits));
+  size_t h = std::hash<std::string>()(key.text);
+  h = hashCombine(h, (size_t)fontId);
+  h = hashCombine(h, (size_t)fontSize);
+  h = hashCombine(h, spacingBits);
+  h = hashCombine(h, useMarkup);
+  key.hash = hashCombine(h, (size_t)backend);
+  return key;
+}
+
+// evictLocked drops the least recently used entries until at most capacity
+// remain.
+static void evictLocked(size_t capacity) {
+  while (entries.size() > capacity) {
+    const TextSizeKey* oldest = lruOrder.back();
+    lruOrder.pop_back();
+    entries.erase(*oldest);
+    cacheStats.evictions++;
+  }
+  cacheStats.entries = (unsigned int)entries.size();
+}
+
+bool FindTextSize(const TextSizeKey& key, TextSize* size) {
+  std::lock_guard<std::mutex> lock(textSizeCacheMutex);
+  auto it = entries.find(key);
+  if (it == entries.end()) {
+    cacheStats.misses++;
+    return false;
+  }
+  cacheStats.hits++;
+  lruOrder.splice(lruOrder.begin(), lruOrder, it->second.order);
+  *size = it->second.size;
+  return true;
+}
+
+void AddTextSize(const TextSizeKey& key, const TextSize& size) {
+  std::lock_guard<std::mutex> lock(textSizeCacheMutex);
+  if (cacheStats.capacity == 0 || key.generation != cacheGeneration) {
+    return;
+  }
+  auto inserted = entries.emplace(key, TextSizeEntry{size, lruOrder.end()});
+  TextSizeEntry& entry = inserted.first->second;
+  if (!inserted.second) {
+    // Measured by two callers at once.
+    entry.size = size;
+    lruOrder.splice(lruOrder.begin(), lruOrder, entry.order);
+    return;
+  }
+  lruOrder.push_front(&inserted.first->first);
+  entry.order = lruOrder.begin();
+  evictLocked(cacheStats.capacity);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void SetTextSizeCacheCapacity(
+    unsigned int capacity) {
+  std::lock_guard<std::mutex> lock(textSizeCacheMutex);
+  cacheStats.capacity = capacity;
+  evictLocked(capacity);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void ClearTextSizeCache() {
+  std::lock_guard<std::mutex> lock(textSizeCacheMutex);
+  lruOrder.clear();
+  entries.clear();
+  cacheStats.entries = 0;
+  cacheGeneration++;
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void GetTextSizeCacheStats(
+    TextSizeCacheStats* stats) {
+  std::lock_guard<std::mutex> lock(textSizeCacheMutex);
+  *stats = cacheStats;
+}
+
+}  // namespace HQText
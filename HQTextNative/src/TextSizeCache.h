@@ -0,0 +1,70 @@
+#ifndef HQTEXT_TEXTSIZECACHE_H
+#define HQTEXT_TEXTSIZECACHE_H
+
+#include <cairo.h>
+#include <cstddef>
+#include <string>
+#include "TextSize.h"
+#include "Unity/IUnityInterface.h"
+
+namespace HQText {
+
+struct TextSizeCacheStats {
+  unsigned long long hits;
+  unsigned long long misses;
+  // Entries dropped to make room for newer ones.
+  unsigned long long evictions;
+  unsigned int entries;
+  unsigned int capacity;
+};
+
+// TextSizeKey is everything a measurement depends on.
+struct TextSizeKey {
+  std::string text;
+  int fontId;
+  int fontSize;
+  float lineSpacing;
+  bool useMarkup;
+  _cairo_font_type backend;
+  // Hash of all of the above, computed once by MakeTextSizeKey.
+  size_t hash;
+  // The cache generation when the key was made, before measuring. It isn't
+  // part of the key's identity.
+  unsigned int generation;
+
+  bool operator==(const TextSizeKey& other) const {
+    return hash == other.hash && fontId == other.fontId &&
+           fontSize == other.fontSize && lineSpacing == other.lineSpacing &&
+           useMarkup == other.useMarkup && backend == other.backend &&
+           text == other.text;
+  }
+};
+
+TextSizeKey MakeTextSizeKey(const char* text,
+                            int fontId,
+                            int fontSize,
+                            float lineSpacing,
+                            bool useMarkup,
+                            _cairo_font_type backend);
+
+// FindTextSize copies the cached measurement for key to size and marks it as
+// the most recently used. Returns false on a miss.
+bool FindTextSize(const TextSizeKey& key, TextSize* size);
+
+// AddTextSize caches a measurement, evicting the least recently used entries
+// beyond the capacity. A measurement that started before the last
+// ClearTextSizeCache may have used the old fonts, so it is dropped.
+void AddTextSize(const TextSizeKey& key, const TextSize& size);
+
+// SetTextSizeCacheCapacity sets how many measurements are kept. 0 disables the
+// cache.
+extern "C" UNITY_INTERFACE_EXPORT void SetTextSizeCacheCapacity(
+    unsigned int capacity);
+// ClearTextSizeCache drops every measurement, e.g. when the fonts change, and
+// starts a new generation, so measurements in flight aren't added.
+extern "C" UNITY_INTERFACE_EXPORT void ClearTextSizeCache();
+extern "C" UNITY_INTERFACE_EXPORT void GetTextSizeCacheStats(
+    TextSizeCacheStats* stats);
+
+}  // namespace HQText
+#endif  // HQTEXT_TEXTSIZECACHE_H
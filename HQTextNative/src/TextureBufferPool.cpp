@@ -0,0 +1,94 @@
+#include "TextureBufferPool.h"
+#include <mutex>
+#include <vector>
+
+namespace HQText {
+
+// Buckets hold power of two pixel counts, starting at 4KB.
+static const int minBucket = 10;
+static const int bucketCount = 32;
+
+static std::vector<uint32_t*> freeLists[bucketCount];
+static TextureBufferPoolStats poolStats = {0, 0, 0, 0, 64ull * 1024 * 1024};
+static std::mutex bufferPoolMutex;
+
+static int bucketForPixels(size_t pixelCount) {
+  int bucket = minBucket;
+  while (bucket < bucketCount - 1 && ((size_t)1 << bucket) < pixelCount) {
+    bucket++;
+  }
+  return bucket;
+}
+
+static unsigned long long bucketBytes(int bucket) {
+  return ((unsigned long long)1 << bucket) * sizeof(uint32_t);
+}
+
+// trimLocked frees the largest pooled buffers first until maxBytes remain.
+static void trimLocked(unsigned long long maxBytes) {
+  for (int bucket = bucketCount - 1;
+       bucket >= 0 && poolStats.pooledBytes > maxBytes; --bucket) {
+    std::vector<uint32_t*>& freeList = freeLists[bucket];
+    while (!freeList.empty() && poolStats.pooledBytes > maxBytes) {
+      delete[] freeList.back();
+      freeList.pop_back();
+      poolStats.pooledBytes -= bucketBytes(bucket);
+    }
+  }
+}
+
+std::shared_ptr<TextureBuffer> AcquireTextureBuffer(size_t pixelCount) {
+  int bucket = bucketForPixels(pixelCount);
+  uint32_t* pixels = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(bufferPoolMutex);
+    std::vector<uint32_t*>& freeList = freeLists[bucket];
+    if (!freeList.empty()) {
+      pixels = freeList.back();
+      freeList.pop_back();
+      poolStats.pooledBytes -= bucketBytes(bucket);
+      poolStats.hits++;
+    } else {
+      poolStats.misses++;
+    }
+    poolStats.inUseBytes += bucketBytes(bucket);
+  }
+  if (pixels == nullptr) {
+    pixels = new uint32_t[(size_t)1 << bucket];
+  }
+  return std::make_shared<TextureBuffer>(pixels, (size_t)1 << bucket,
+                                         pixelCount);
+}
+
+TextureBuffer::~TextureBuffer() {
+  int bucket = bucketForPixels(capacity);
+  std::lock_guard<std::mutex> lock(bufferPoolMutex);
+  poolStats.inUseBytes -= bucketBytes(bucket);
+  if (poolStats.pooledBytes + bucketBytes(bucket) > poolStats.limitBytes) {
+    delete[] pixels;
+    return;
+  }
+  freeLists[bucket].push_back(pixels);
+  poolStats.pooledBytes += bucketBytes(bucket);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void SetTextureBufferPoolLimit(
+    unsigned long long limitBytes) {
+  std::lock_guard<std::mutex> lock(bufferPoolMutex);
+  poolStats.limitBytes = limitBytes;
+  trimLocked(limitBytes);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void TrimTextureBufferPool(
+    unsigned long long maxBytes) {
+  std::lock_guard<std::mutex> lock(bufferPoolMutex);
+  trimLocked(maxBytes);
+}
+
+extern "C" UNITY_INTERFACE_EXPORT void GetTextureBufferPoolStats(
+    TextureBufferPoolStats* stats) {
+  std::lock_guard<std::mutex> lock(bufferPoolMutex);
+  *stats = poolStats;
+}
+
+}  // namespace HQText
@@ -0,0 +1,50 @@
+#ifndef HQTEXT_TEXTUREBUFFERPOOL_H
+#define HQTEXT_TEXTUREBUFFERPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "Unity/IUnityInterface.h"
+
+namespace HQText {
+
+struct TextureBufferPoolStats {
+  unsigned long long hits;
+  unsigned long long misses;
+  // Bytes held in the pool's free lists.
+  unsigned long long pooledBytes;
+  // Bytes currently handed out.
+  unsigned long long inUseBytes;
+  unsigned long long limitBytes;
+};
+
+// TextureBuffer is pixel memory from the pool. Its capacity is rounded up to a
+// power of two and it returns to the pool when destroyed.
+struct TextureBuffer {
+  uint32_t* pixels = nullptr;
+  size_t capacity = 0;
+  size_t size = 0;
+
+  TextureBuffer(uint32_t* p, size_t c, size_t s)
+      : pixels(p), capacity(c), size(s) {}
+  TextureBuffer(const TextureBuffer&) = delete;
+  TextureBuffer& operator=(const TextureBuffer&) = delete;
+  ~TextureBuffer();
+};
+
+// AcquireTextureBuffer returns a buffer holding at least pixelCount pixels. The
+// contents are undefined.
+std::shared_ptr<TextureBuffer> AcquireTextureBuffer(size_t pixelCount);
+
+// SetTextureBufferPoolLimit caps the memory kept in the pool for reuse and
+// frees anything above it. Buffers in use don't count towards the limit.
+extern "C" UNITY_INTERFACE_EXPORT void SetTextureBufferPoolLimit(
+    unsigned long long limitBytes);
+// TrimTextureBufferPool frees pooled buffers until at most maxBytes remain.
+extern "C" UNITY_INTERFACE_EXPORT void TrimTextureBufferPool(
+    unsigned long long maxBytes);
+extern "C" UNITY_INTERFACE_EXPORT void GetTextureBufferPoolStats(
+    TextureBufferPoolStats* stats);
+
+}  // namespace HQText
+#endif  // HQTEXT_TEXTUREBUFFERPOOL_H
@@ -0,0 +1,96 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include "FontMapPool.h"
+
+namespace HQText {
+
+ThreadPool::ThreadPool(int threadCount) {
+  threadCount = std::max(threadCount, 1);
+  for (int i = 0; i < threadCount; ++i) {
+    queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+  }
+  for (int i = 0; i < threadCount; ++i) {
+    workers.emplace_back(&ThreadPool::run, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::Submit(Job job) {
+  unsigned int queue = nextQueue++ % queues.size();
+  {
+    std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+    queues[queue]->jobs.push_back(std::move(job));
+  }
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    pending++;
+  }
+  wake.notify_one();
+}
+
+// popJob takes the oldest job from the worker's own queue, or steals the
+// newest job from another queue.
+bool ThreadPool::popJob(int worker, Job& job) {
+  int count = (int)queues.size();
+  for (int i = 0; i < count; ++i) {
+    WorkQueue& queue = *queues[(worker + i) % count];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) {
+      continue;
+    }
+    if (i == 0) {
+      job = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+    } else {
+      job = std::move(queue.jobs.back());
+      queue.jobs.pop_back();
+    }
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::run(int worker) {
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      wake.wait(lock, [this] { return stopping || pending > 0; });
+      if (stopping) {
+        return;
+      }
+      // Claim a job before looking for it, so that two workers never wait
+      // on the same one.
+      pending--;
+    }
+    Job job;
+    // There is a job for every claim, but another worker may take the one
+    // this scan would have found first.
+    while (!popJob(worker, job)) {
+      std::this_thread::yield();
+    }
+    job(worker);
+  }
+}
+
+ThreadPool& LayoutThreadPool() {
+  // Never destroyed: joining threads while the plugin is being unloaded can
+  // deadlock on Windows.
+  static ThreadPool* pool = [] {
+    int threads = (int)std::thread::hardware_concurrency() - 1;
+    threads = std::min(std::max(threads, 1), FontMapLaneCount - 1);
+    return new ThreadPool(threads);
+  }();
+  return *pool;
+}
+
+}  // namespace HQText
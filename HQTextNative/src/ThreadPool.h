@@ -0,0 +1,56 @@
+#ifndef HQTEXT_THREADPOOL_H
+#define HQTEXT_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace HQText {
+
+// ThreadPool runs jobs on a fixed set of worker threads. Each worker has its
+// own queue, and a worker that runs out of jobs steals from the others, so a
+// batch submitted from one thread is spread across all of them.
+class ThreadPool {
+ public:
+  typedef std::function<void(int worker)> Job;
+
+  explicit ThreadPool(int threadCount);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Submit queues job. It is passed the index of the worker that runs it.
+  void Submit(Job job);
+
+  int ThreadCount() const { return (int)workers.size(); }
+
+ private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  void run(int worker);
+  bool popJob(int worker, Job& job);
+
+  std::vector<std::thread> workers;
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+  std::atomic<unsigned int> nextQueue{0};
+  // Guards sleeping and waking; pending is the number of queued jobs.
+  std::mutex wakeMutex;
+  std::condition_variable wake;
+  int pending = 0;
+  bool stopping = false;
+};
+
+// LayoutThreadPool returns the pool used for asynchronous layout, creating it
+// on first use with one worker per font map lane. Worker i uses lane i + 1.
+ThreadPool& LayoutThreadPool();
+
+}  // namespace HQText
+#endif  // HQTEXT_THREADPOOL_H
@@ -0,0 +1,286 @@
+#include <cairo.h>
+#include <pango/pangocairo.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../Plugin.h"
+
+using namespace HQText;
+
+#ifdef _WIN32
+static const _cairo_font_type backend = CAIRO_FONT_TYPE_WIN32;
+#else
+static const _cairo_font_type backend = CAIRO_FONT_TYPE_FT;
+#endif
+
+// Fonts checked, taken from the start of the backend's family list.
+static const int maxFamilies = 16;
+static const int fontSize = 24;
+
+static int failures = 0;
+// Labels checked, and how many of them were laid out twice.
+static int layouts = 0;
+static int relayouts = 0;
+
+struct Box {
+  int width;
+  int height;
+  int widthLogical;
+  int heightLogical;
+  int lineCount;
+  int layoutPasses;
+};
+
+struct Padding {
+  int left;
+  int right;
+  int top;
+  int bottom;
+};
+
+struct LabelCase {
+  const char* name;
+  int textBoxWidth;
+  int textBoxHeight;
+  HorizontalWrapping wrappingH;
+  VerticalWrapping wrappingV;
+};
+
+static const LabelCase labelCases[] = {
+    {"unwrapped", 400, 100, ExpandH, ExpandV},
+    {"wrapped", 120, 100, WrapH, ExpandV},
+    {"height limited", 120, 40, WrapH, ClipV},
+    {"clipped", 80, 30, ClipH, ClipV},
+};
+
+// Text that overhangs its logical boxes in most fonts: italic like bearings,
+// stacked marks, and a very wide ligature.
+static const char* texts[] = {
+    "fjord jiffy Typography",
+    "The quick brown fox jumps over the lazy dog",
+    "A\xcc\x8a\xcc\x81 a\xcc\x83\xcc\x88\xcc\xa4\xcc\xa4 \xe1\xba\xb5",
+    "\xef\xb7\xbd wide",
+    "",
+};
+
+// readInt16 reads a big endian value from a font table, or 0 past its end.
+static int readInt16(const char* data, unsigned int length, unsigned int at) {
+  if (data == nullptr || at + 2 > length) {
+    return 0;
+  }
+  return (int16_t)(((uint8_t)data[at] << 8) | (uint8_t)data[at + 1]);
+}
+
+// fontInkBounds returns how far, in pixels, the glyphs of the font reach
+// outside their logical boxes, from the hhea side bearings and the head
+// bounding box.
+static Padding fontInkBounds(PangoContext* context,
+                             const PangoFontDescription* description) {
+  Padding bounds = {0, 0, 0, 0};
+  PangoFont* font = pango_context_load_font(context, description);
+  if (font == nullptr) {
+    return bounds;
+  }
+  hb_face_t* face = hb_font_get_face(pango_font_get_hb_font(font));
+  hb_blob_t* head = hb_face_reference_table(face, HB_TAG('h', 'e', 'a', 'd'));
+  hb_blob_t* hhea = hb_face_reference_table(face, HB_TAG('h', 'h', 'e', 'a'));
+  unsigned int headLength;
+  unsigned int hheaLength;
+  const char* headData = hb_blob_get_data(head, &headLength);
+  const char* hheaData = hb_blob_get_data(hhea, &hheaLength);
+  int ascender = readInt16(hheaData, hheaLength, 4);
+  int descender = readInt16(hheaData, hheaLength, 6);
+  int yMin = readInt16(headData, headLength, 38);
+  int yMax = readInt16(headData, headLength, 42);
+  float upem = (float)std::max(hb_face_get_upem(face), 1u);
+  float left = std::max(-readInt16(hheaData, hheaLength, 12), 0) / upem;
+  float right = std::max(-readInt16(hheaData, hheaLength, 14), 0) / upem;
+  float top = std::max(yMax - ascender, 0) / upem;
+  float bottom = std::max(descender - yMin, 0) / upem;
+  hb_blob_destroy(head);
+  hb_blob_destroy(hhea);
+  g_object_unref(font);
+
+  double pixelSize = fontSize;
+  bounds.left = (int)std::ceil(left * pixelSize);
+  bounds.right = (int)std::ceil(right * pixelSize);
+  bounds.top = (int)std::ceil(top * pixelSize);
+  bounds.bottom = (int)std::ceil(bottom * pixelSize);
+  return bounds;
+}
+
+// inkOverflow returns how far the ink of the layout reaches outside its
+// logical rect, in pixels.
+static Padding inkOverflow(PangoLayout* layout,
+                           PangoRectangle* ink,
+                           PangoRectangle* logical) {
+  pango_layout_get_extents(layout, ink, logical);
+  int inkX = ink->x / PANGO_SCALE;
+  int inkY = ink->y / PANGO_SCALE;
+  int inkRight = inkX + ink->width / PANGO_SCALE;
+  int inkBottom = inkY + ink->height / PANGO_SCALE;
+  int logicalRight = logical->x / PANGO_SCALE + logical->width / PANGO_SCALE;
+  int logicalBottom =
+      logical->y / PANGO_SCALE + logical->height / PANGO_SCALE;
+  Padding overflow;
+  overflow.left = std::max(-inkX, 0);
+  overflow.top = std::max(-inkY, 0);
+  overflow.right = std::max(inkRight - logicalRight, 0);
+  overflow.bottom = std::max(inkBottom - logicalBottom, 0);
+  return overflow;
+}
+
+// expectedLayoutBox lays text out the way automatic padding should: in the
+// box less the font's ink bounds when they shape the layout, and once more in
+// the box less the measured overhang only if wrapped text overhangs further
+// than the bounds.
+static Box expectedLayoutBox(PangoContext* context,
+                             const PangoFontDescription* baseDescription,
+                             const char* text,
+                             const LabelCase& label) {
+  PangoLayout* layout = pango_layout_new(context);
+  PangoFontDescription* description =
+      pango_font_description_copy(baseDescription);
+  pango_font_description_set_absolute_size(description,
+                                           (double)fontSize * PANGO_SCALE);
+  pango_layout_set_text(layout, text, -1);
+  pango_layout_set_alignment(layout, PANGO_ALIGN_LEFT);
+  pango_layout_set_wrap(layout, PANGO_WRAP_WORD_CHAR);
+  pango_layout_set_font_description(layout, description);
+
+  Padding padding = {0, 0, 0, 0};
+  if (label.wrappingH == WrapH || label.wrappingV != ExpandV) {
+    padding = fontInkBounds(context, description);
+  }
+  pango_font_description_free(description);
+
+  int boxWidth = label.textBoxWidth * PANGO_SCALE;
+  int boxHeight = label.textBoxHeight * PANGO_SCALE;
+  auto applyPadding = [&]() {
+    pango_layout_set_width(
+        layout, label.wrappingH == WrapH
+                    ? boxWidth - (padding.left + padding.right) * PANGO_SCALE
+                    : -1);
+    pango_layout_set_height(
+        layout, label.wrappingV == ExpandV
+                    ? -1
+                    : boxHeight - (padding.top + padding.bottom) * PANGO_SCALE);
+  };
+  applyPadding();
+  PangoRectangle ink;
+  PangoRectangle logical;
+  Padding measured = inkOverflow(layout, &ink, &logical);
+  int passes = 1;
+  bool reserved = measured.left + measured.right <=
+                  padding.left + padding.right;
+  padding = measured;
+  if (label.wrappingH == WrapH && !reserved) {
+    applyPadding();
+    pango_layout_get_extents(layout, &ink, &logical);
+    passes++;
+  }
+
+  int renderWidth =
+      logical.width + (padding.left + padding.right) * PANGO_SCALE;
+  if (renderWidth > boxWidth && label.wrappingH != ExpandH) {
+    renderWidth = boxWidth;
+  }
+  int renderHeight =
+      logical.height + (padding.top + padding.bottom) * PANGO_SCALE;
+  if (renderHeight > boxHeight && label.wrappingV != ExpandV) {
+    renderHeight = boxHeight;
+  }
+  Box box = {renderWidth / PANGO_SCALE, renderHeight / PANGO_SCALE,
+             logical.width / PANGO_SCALE, logical.height / PANGO_SCALE,
+             pango_layout_get_line_count(layout), passes};
+  g_object_unref(layout);
+  return box;
+}
+
+static Box newLayoutBox(unsigned int index,
+                        int fontId,
+                        const char* text,
+                        const LabelCase& label) {
+  Color color;
+  color.a = 1;
+  TextInfo info = SetTextDataWithFontId(
+      index, const_cast<char*>(text), fontId, fontSize, label.textBoxWidth,
+      label.textBoxHeight, color, PANGO_ALIGN_LEFT, 0, false, false,
+      PANGO_DIRECTION_LTR, VerticalAlignment::top, label.wrappingH,
+      label.wrappingV, false, 1, true);
+  Box box = {info.width,         info.height,    info.widthLogical,
+             info.heightLogical, info.lineCount, info.layoutPasses};
+  return box;
+}
+
+int main() {
+  PangoFontMap* fontMap = pango_cairo_font_map_new_for_font_type(backend);
+  if (fontMap == nullptr) {
+    printf("no font map for backend %d, skipped\n", (int)backend);
+    return 0;
+  }
+  PangoContext* context = pango_font_map_create_context(fontMap);
+  cairo_font_options_t* options = cairo_font_options_create();
+  cairo_font_options_set_antialias(options, CAIRO_ANTIALIAS_GRAY);
+  pango_cairo_context_set_font_options(context, options);
+  cairo_font_options_destroy(options);
+  pango_context_set_base_dir(context, PANGO_DIRECTION_LTR);
+
+  PangoFontFamily** families;
+  int familyCount;
+  pango_font_map_list_families(fontMap, &families, &familyCount);
+  unsigned int index = Initialize();
+  for (int f = 0; f < familyCount && f < maxFamilies; ++f) {
+    PangoFontFace** faces;
+    int faceCount;
+    pango_font_family_list_faces(families[f], &faces, &faceCount);
+    if (faceCount > 0) {
+      const char* family = pango_font_family_get_name(families[f]);
+      const char* face = pango_font_face_get_face_name(faces[0]);
+      int fontId = RegisterFont(family, face, backend);
+      PangoFontDescription* description = pango_font_face_describe(faces[0]);
+      for (const LabelCase& label : labelCases) {
+        for (const char* text : texts) {
+          Box expected = expectedLayoutBox(context, description, text, label);
+          Box actual = newLayoutBox(index, fontId, text, label);
+          if (expected.width != actual.width ||
+              expected.height != actual.height ||
+              expected.widthLogical != actual.widthLogical ||
+              expected.heightLogical != actual.heightLogical ||
+              expected.lineCount != actual.lineCount ||
+              expected.layoutPasses != actual.layoutPasses) {
+            printf("%s %s, %s, \"%s\": got %dx%d (logical %dx%d, %d lines, "
+                   "%d passes), expected %dx%d (logical %dx%d, %d lines, "
+                   "%d passes)\n",
+                   family, face, label.name, text, actual.width, actual.height,
+                   actual.widthLogical, actual.heightLogical, actual.lineCount,
+                   actual.layoutPasses, expected.width, expected.height,
+                   expected.widthLogical, expected.heightLogical,
+                   expected.lineCount, expected.layoutPasses);
+            ++failures;
+          }
+          ++layouts;
+          if (actual.layoutPasses > 1) {
+            ++relayouts;
+          }
+        }
+      }
+      pango_font_description_free(description);
+    }
+    g_free(faces);
+  }
+  g_free(families);
+  Teardown(index);
+  g_object_unref(context);
+  g_object_unref(fontMap);
+
+  printf("%d of %d layouts needed a second pass\n", relayouts, layouts);
+  if (failures != 0) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,76 @@
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "../PixelConversion.h"
+
+using namespace HQText;
+
+typedef void (*RowFunc)(const uint32_t*, uint32_t*, int, bool);
+
+static const int imageWidth = 2048;
+static const int imageHeight = 2048;
+static const int repeats = 10;
+
+// floatLoopRow is the per-pixel float loop the plugin used before the
+// kernels, kept as the baseline. It truncates instead of rounding.
+static void floatLoopRow(const uint32_t* src,
+                         uint32_t* dst,
+                         int width,
+                         bool swapRedBlue) {
+  (void)swapRedBlue;
+  auto bytes = reinterpret_cast<const unsigned char*>(src);
+  for (int x = 0; x < width; ++x) {
+    unsigned char a = bytes[x * 4 + 3];
+    unsigned char r = bytes[x * 4 + 0];
+    unsigned char g = bytes[x * 4 + 1];
+    unsigned char b = bytes[x * 4 + 2];
+    float aFloat = ((float)a / 255.0);
+    if (a > 0) {
+      r /= aFloat;
+      g /= aFloat;
+      b /= aFloat;
+    }
+    dst[x] = (uint32_t)a << 24 | r << 16 | g << 8 | b;
+  }
+}
+
+// run times a kernel over the image and prints its throughput
+// in megapixels per second.
+static void run(const char* name,
+                RowFunc kernel,
+                const std::vector<uint32_t>& src,
+                std::vector<uint32_t>& dst) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeats; ++i) {
+    for (int y = 0; y < imageHeight; ++y) {
+      kernel(src.data() + (size_t)y * imageWidth,
+             dst.data() + (size_t)y * imageWidth, imageWidth, true);
+    }
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  double pixels = (double)imageWidth * imageHeight * repeats;
+  printf("%-8s %8.1f MPix/s\n", name, pixels / elapsed.count() / 1e6);
+}
+
+int main() {
+  // Text is mostly transparent or opaque, with antialiased edges between.
+  std::vector<uint32_t> src((size_t)imageWidth * imageHeight);
+  std::vector<uint32_t> dst(src.size());
+  uint32_t seed = 1;
+  for (uint32_t& p : src) {
+    seed = seed * 1664525 + 1013904223;
+    uint32_t a = (seed >> 24) & 0xFF;
+    uint32_t c = a == 0 ? 0 : (seed >> 8) % (a + 1);
+    p = a << 24 | c << 16 | c << 8 | c;
+  }
+  run("float", floatLoopRow, src, dst);
+  run("scalar", UnpremultiplyRowScalar, src, dst);
+#ifdef HQTEXT_X86
+  run("sse2", UnpremultiplyRowSSE2, src, dst);
+  if (CpuSupportsAVX2()) {
+    run("avx2", UnpremultiplyRowAVX2, src, dst);
+  }
+#endif
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include <cstdio>
+#include <vector>
+#include "../PixelConversion.h"
+
+using namespace HQText;
+
+typedef void (*RowFunc)(const uint32_t*, uint32_t*, int, bool);
+
+static int failures = 0;
+
+// makeRow fills a row with every colour value for one alpha. Each channel
+// walks the values in a different order, so a swapped channel shows up.
+static void makeRow(uint32_t a, uint32_t* row) {
+  for (uint32_t c = 0; c < 256; ++c) {
+    uint32_t r = c;
+    uint32_t g = (c * 7 + 3) & 0xFF;
+    uint32_t b = 255 - c;
+    row[c] = a << 24 | r << 16 | g << 8 | b;
+  }
+}
+
+// checkScalar compares the scalar kernel with c * 255 / a rounded to nearest,
+// for every valid premultiplied pair c <= a.
+static void checkScalar() {
+  uint32_t src[256];
+  uint32_t dst[256];
+  for (uint32_t a = 0; a < 256; ++a) {
+    for (uint32_t c = 0; c < 256; ++c) {
+      src[c] = a << 24 | c << 16 | c << 8 | c;
+    }
+    UnpremultiplyRowScalar(src, dst, 256, false);
+    for (uint32_t c = 0; c <= a; ++c) {
+      uint32_t expected = a == 0 ? 0 : (c * 255 + a / 2) / a;
+      uint32_t p = dst[c];
+      if ((p >> 24) != a || (p & 0xFF) != expected ||
+          ((p >> 8) & 0xFF) != expected || ((p >> 16) & 0xFF) != expected) {
+        printf("scalar: a=%u c=%u gave %08x, expected %u\n", a, c, p,
+               expected);
+        ++failures;
+      }
+    }
+  }
+}
+
+// checkKernel runs every (a, c) pair through a SIMD kernel and the scalar one
+// and requires identical output. The row start is offset and the width
+// trimmed so that unaligned loads and every tail length are covered.
+static void checkKernel(const char* name, RowFunc kernel) {
+  std::vector<uint32_t> src(256 + 8);
+  std::vector<uint32_t> expected(256 + 8);
+  std::vector<uint32_t> actual(256 + 8);
+  for (uint32_t a = 0; a < 256; ++a) {
+    for (int offset = 0; offset < 4; ++offset) {
+      makeRow(a, src.data() + offset);
+      for (int width = 256; width > 248; --width) {
+        for (int swap = 0; swap < 2; ++swap) {
+          const uint32_t* row = src.data() + offset;
+          UnpremultiplyRowScalar(row, expected.data(), width, swap != 0);
+          kernel(row, actual.data() + offset, width, swap != 0);
+          for (int x = 0; x < width; ++x) {
+            if (actual[offset + x] != expected[x]) {
+              printf("%s: a=%u x=%d offset=%d width=%d swap=%d gave %08x, "
+                     "expected %08x\n",
+                     name, a, x, offset, width, swap, actual[offset + x],
+                     expected[x]);
+              ++failures;
+              break;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+int main() {
+  checkScalar();
+#ifdef HQTEXT_X86
+  checkKernel("sse2", UnpremultiplyRowSSE2);
+  if (CpuSupportsAVX2()) {
+    checkKernel("avx2", UnpremultiplyRowAVX2);
+  } else {
+    printf("avx2: not supported by this cpu, skipped\n");
+  }
+#endif
+  if (failures != 0) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include <pango/pango.h>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "../RasterDamage.h"
+
+using namespace HQText;
+
+static const int surfaceWidth = 256;
+static const int surfaceHeight = 200;
+static const int lineHeight = 20;
+static const int lineCount = 100;
+static const int clustersPerLine = 20;
+static const int clusterWidth = 12;
+
+static int failures = 0;
+
+// stampText stamps a text of lineCount lines scrolled down by scrollY rows,
+// culling clusters off the surface like StampClusters does.
+static std::vector<ClusterStamp> stampText(int scrollY) {
+  const int cullMargin = 4 * PANGO_SCALE;
+  std::vector<ClusterStamp> stamps;
+  stamps.push_back(ClusterStamp{0, 0, surfaceWidth * PANGO_SCALE,
+                                surfaceHeight * PANGO_SCALE,
+                                SurfaceStampFontKey, 1});
+  for (int line = 0; line < lineCount; ++line) {
+    // Descenders reach a little into the next line.
+    int top = (line * lineHeight - scrollY) * PANGO_SCALE;
+    int height = (lineHeight + 3) * PANGO_SCALE;
+    if (top + height < -cullMargin ||
+        top > surfaceHeight * PANGO_SCALE + cullMargin) {
+      continue;
+    }
+    for (int c = 0; c < clustersPerLine; ++c) {
+      stamps.push_back(ClusterStamp{c * clusterWidth * PANGO_SCALE, top,
+                                    clusterWidth * PANGO_SCALE, height, 0,
+                                    (uint64_t)(line * clustersPerLine + c)});
+    }
+  }
+  std::sort(stamps.begin(), stamps.end());
+  return stamps;
+}
+
+static void check(const char* name, bool passed, TextureRect region) {
+  if (!passed) {
+    printf("%s: damaged %d,%d %dx%d\n", name, region.x, region.y, region.width,
+           region.height);
+    ++failures;
+  }
+}
+
+int main() {
+  std::vector<ClusterStamp> before = stampText(100);
+
+  TextureRect same = DamagedRegion(before, stampText(100), surfaceWidth,
+                                   surfaceHeight);
+  check("unchanged", same.width == 0 && same.height == 0, same);
+
+  // Scrolling moves every cluster that stays visible along with the pixels,
+  // so nothing outside the rows scrolled into view needs drawing again.
+  for (int delta : {1, lineHeight, -lineHeight, 3 * lineHeight + 7}) {
+    TextureRect region = ScrollDamagedRegion(
+        before, stampText(100 + delta), delta, surfaceWidth, surfaceHeight);
+    check("scroll", region.width == 0 && region.height == 0, region);
+  }
+
+  // A one line scroll that also changes a visible cluster damages about that
+  // cluster's line, not the whole surface.
+  std::vector<ClusterStamp> after = stampText(100 + lineHeight);
+  for (ClusterStamp& stamp : after) {
+    if (stamp.fontKey == 0 && stamp.y == 5 * lineHeight * PANGO_SCALE) {
+      stamp.content ^= 0xFF;
+    }
+  }
+  TextureRect changed = ScrollDamagedRegion(before, after, lineHeight,
+                                            surfaceWidth, surfaceHeight);
+  check("scroll and change",
+        changed.height > 0 && changed.height <= lineHeight + 8, changed);
+
+  if (failures != 0) {
+    printf("%d failures\n", failures);
+    return 1;
+  }
+  return 0;
+}
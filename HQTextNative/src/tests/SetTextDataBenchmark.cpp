@@ -0,0 +1,105 @@
+#include <cairo.h>
+#include <pango/pangocairo.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../Plugin.h"
+
+using namespace HQText;
+
+#ifdef _WIN32
+static const _cairo_font_type backend = CAIRO_FONT_TYPE_WIN32;
+#else
+static const _cairo_font_type backend = CAIRO_FONT_TYPE_FT;
+#endif
+
+static const int labelCount = 200;
+static const int updatesPerLabel = 5;
+static const int fontSize = 24;
+static const int textBoxWidth = 300;
+static const int textBoxHeight = 100;
+
+static std::string labelText(int label, int update) {
+  return "Label " + std::to_string(label) + ", update " +
+         std::to_string(update) +
+         ": The quick brown fox jumps over the lazy dog";
+}
+
+// perLabelUpdate lays a label out the way SetTextData did before font maps
+// and contexts were shared: with a font map and context of its own.
+static void perLabelUpdate(const PangoFontDescription* baseDescription,
+                           const std::string& text) {
+  PangoFontMap* fontMap = pango_cairo_font_map_new_for_font_type(backend);
+  PangoContext* context = pango_font_map_create_context(fontMap);
+  cairo_font_options_t* options = cairo_font_options_create();
+  cairo_font_options_set_antialias(options, CAIRO_ANTIALIAS_GRAY);
+  pango_cairo_context_set_font_options(context, options);
+  cairo_font_options_destroy(options);
+  PangoLayout* layout = pango_layout_new(context);
+
+  PangoFontDescription* description =
+      pango_font_description_copy(baseDescription);
+  pango_font_description_set_absolute_size(description,
+                                           (double)fontSize * PANGO_SCALE);
+  pango_layout_set_font_description(layout, description);
+  pango_font_description_free(description);
+  pango_layout_set_wrap(layout, PANGO_WRAP_WORD_CHAR);
+  pango_layout_set_width(layout, textBoxWidth * PANGO_SCALE);
+  pango_layout_set_text(layout, text.c_str(), -1);
+  PangoRectangle ink;
+  PangoRectangle logical;
+  pango_layout_get_extents(layout, &ink, &logical);
+
+  g_object_unref(layout);
+  g_object_unref(context);
+  g_object_unref(fontMap);
+}
+
+// report prints the mean latency of one label update.
+static void report(const char* name,
+                   std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  printf("%-10s %8.1f us per update\n", name,
+         elapsed.count() / (labelCount * updatesPerLabel));
+}
+
+int main() {
+  int fontId = RegisterFont("Sans", "Regular", backend);
+  PangoFontDescription* description =
+      pango_font_description_from_string("Sans");
+
+  auto start = std::chrono::steady_clock::now();
+  for (int update = 0; update < updatesPerLabel; ++update) {
+    for (int label = 0; label < labelCount; ++label) {
+      perLabelUpdate(description, labelText(label, update));
+    }
+  }
+  report("per label", start);
+
+  std::vector<unsigned int> labels;
+  for (int label = 0; label < labelCount; ++label) {
+    labels.push_back(Initialize());
+  }
+  Color color;
+  color.a = 1;
+  start = std::chrono::steady_clock::now();
+  for (int update = 0; update < updatesPerLabel; ++update) {
+    for (int label = 0; label < labelCount; ++label) {
+      std::string text = labelText(label, update);
+      SetTextDataWithFontId(labels[label], const_cast<char*>(text.c_str()),
+                            fontId, fontSize, textBoxWidth, textBoxHeight,
+                            color, PANGO_ALIGN_LEFT, 0, false, false,
+                            PANGO_DIRECTION_LTR, VerticalAlignment::top,
+                            WrapH, ExpandV, false, 1, true);
+    }
+  }
+  report("shared", start);
+
+  for (unsigned int label : labels) {
+    Teardown(label);
+  }
+  pango_font_description_free(description);
+  return 0;
+}
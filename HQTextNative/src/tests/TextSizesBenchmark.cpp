@@ -0,0 +1,78 @@
+#include <cairo.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "../Plugin.h"
+#include "../TextSizeCache.h"
+
+using namespace HQText;
+
+#ifdef _WIN32
+static const _cairo_font_type backend = CAIRO_FONT_TYPE_WIN32;
+#else
+static const _cairo_font_type backend = CAIRO_FONT_TYPE_FT;
+#endif
+
+static const int stringCount = 4096;
+static const int fontSize = 24;
+
+// corpusString returns a unique string mixing Latin and Arabic, so every
+// measurement shapes both scripts and none is served by another's result.
+static std::string corpusString(int i) {
+  static const char* latin[] = {"The quick brown fox", "jumps over",
+                                "the lazy dog", "Layout"};
+  static const char* arabic[] = {
+      "\xD9\x85\xD8\xB1\xD8\xAD\xD8\xA8\xD8\xA7 \xD8\xA8\xD8\xA7\xD9\x84"
+      "\xD8\xB9\xD8\xA7\xD9\x84\xD9\x85",
+      "\xD8\xA7\xD9\x84\xD9\x86\xD8\xB5 \xD8\xA7\xD9\x84\xD8\xB9\xD8\xB1"
+      "\xD8\xA8\xD9\x8A",
+      "\xD9\x83\xD8\xAA\xD8\xA7\xD8\xA8"};
+  return std::string(latin[i % 4]) + " " + arabic[i % 3] + " " +
+         std::to_string(i);
+}
+
+// report prints the mean time to measure one string.
+static void report(const char* name,
+                   std::chrono::steady_clock::time_point start) {
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  printf("%-10s %8.2f us per string\n", name, elapsed.count() / stringCount);
+}
+
+int main() {
+  int fontId = RegisterFont("Sans", "Regular", backend);
+  std::vector<std::string> corpus;
+  std::vector<const char*> strings;
+  for (int i = 0; i < stringCount; ++i) {
+    corpus.push_back(corpusString(i));
+  }
+  for (const std::string& s : corpus) {
+    strings.push_back(s.c_str());
+  }
+  std::vector<TextSize> sizes(stringCount, TextSize(0, 0, 0, 0));
+
+  // Without the cache, both measure every string.
+  SetTextSizeCacheCapacity(0);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < stringCount; ++i) {
+    sizes[i] = GetTextSizeWithFontId(const_cast<char*>(strings[i]), fontId,
+                                     fontSize, 0, false);
+  }
+  report("per string", start);
+
+  start = std::chrono::steady_clock::now();
+  GetTextSizes(strings.data(), stringCount, fontId, fontSize, 0, false,
+               sizes.data());
+  report("batch", start);
+
+  // Measuring the batch again is served from the cache.
+  SetTextSizeCacheCapacity(stringCount);
+  GetTextSizes(strings.data(), stringCount, fontId, fontSize, 0, false,
+               sizes.data());
+  start = std::chrono::steady_clock::now();
+  GetTextSizes(strings.data(), stringCount, fontId, fontSize, 0, false,
+               sizes.data());
+  report("cached", start);
+  return 0;
+}
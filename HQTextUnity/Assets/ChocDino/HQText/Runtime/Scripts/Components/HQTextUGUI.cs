@@ -146,6 +146,14 @@ namespace ChocDino.HQText
 			Rect rect = GetPixelAdjustedRect();
 			Rect textRect = _coreComponent.GetTextTextureRect(rect);
 
+			// Alpha8 textures only hold the coverage of the text, which the UI shaders sample as white, so
+			// the text colour comes with the vertices.
+			Color vertexColor = color;
+			if (tex.format == TextureFormat.Alpha8)
+			{
+				vertexColor *= _coreComponent.Properties.TextColor;
+			}
+
 			// Render the whole rectangle if all letters should be shown.
 			// This shouldn't really be necessary, but the rectangles we currently get
 			// from Pango don't cover the characters completely.
@@ -157,7 +165,7 @@ namespace ChocDino.HQText
 				var right = textRect.x + textRect.width;
 				var bot = textRect.y;
 				var top = textRect.y + textRect.height;
-				var color32 = color;
+				var color32 = vertexColor;
 				var v = new Vector3(left, bot);
 				vh.AddVert(v, color32, posToUV(v));
 				v = new Vector3(left, top);
@@ -184,7 +192,7 @@ namespace ChocDino.HQText
 				// Rects are on the texture
 				var charRect = _coreComponent.Properties.CharacterRects[charIdx];
 
-				var color32 = color;
+				var color32 = vertexColor;
 				// Values of the character rect's edges is Unity, clamped to stay within the bound of the text
 				// rectangle.
 				var left = Mathf.Clamp(textRect.x + charRect.X, textRect.x, textRect.x + textRect.width);
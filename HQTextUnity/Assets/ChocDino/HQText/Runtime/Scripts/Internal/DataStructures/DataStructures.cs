@@ -29,7 +29,27 @@ namespace ChocDino.HQText.Internal
 		public int Ascent;
 		public int Descent;
 		public int LineHeight;
+		/// <summary>Non-zero if the texture holds premultiplied alpha colours</summary>
+		public int PremultipliedAlpha;
+		/// <summary>The format the label's texture was last written in, or the preferred format before the first write</summary>
+		public RasterFormat TextureFormat;
+		/// <summary>The height of the whole text including padding, which only differs from Height with a viewport</summary>
+		public int DocumentHeight;
+		/// <summary>The first character of the laid out window of a label with a viewport</summary>
+		public int FirstCharacter;
+		/// <summary>The texture format the label is best rasterized in</summary>
+		public RasterFormat PreferredTextureFormat;
+		/// <summary>How many times the text was laid out for its current layout</summary>
+		public int LayoutPasses;
 	}
+
+	/// <summary>
+	/// The pixel layout of a label's texture. Alpha8 holds only the coverage of the text, for labels
+	/// drawn in a single colour, and the colour has to be applied by the material. The native
+	/// plugin writes the format of the texture it updates: Alpha8 for TextureFormat.Alpha8 and R8,
+	/// BGRA32 for BGRA32 and RGBAHalf for RGBAHalf textures.
+	/// </summary>
+	public enum RasterFormat { RGBA32 = 0, Alpha8 = 1, BGRA32 = 2, RGBAHalf = 3 }
 	[Serializable]
 	public struct TextPadding
 	{
@@ -51,6 +71,177 @@ namespace ChocDino.HQText.Internal
 		public override string ToString() { return $"Rectangle [x={X},y={Y},w={Width},h={Height}]"; }
 	}
 
+	/// <summary>
+	/// Counters for the native pool that texture pixel buffers are recycled through
+	/// </summary>
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TextureBufferPoolStats
+	{
+		public ulong Hits;
+		public ulong Misses;
+		public ulong PooledBytes;
+		public ulong InUseBytes;
+		public ulong LimitBytes;
+	}
+
+	/// <summary>
+	/// Counters for the native cache of GetTextSize measurements
+	/// </summary>
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TextSizeCacheStats
+	{
+		public ulong Hits;
+		public ulong Misses;
+		public ulong Evictions;
+		public uint Entries;
+		public uint Capacity;
+	}
+
+	/// <summary>
+	/// A region of a texture in pixels, with row 0 at the bottom
+	/// </summary>
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TextureRect
+	{
+		public int X;
+		public int Y;
+		public int Width;
+		public int Height;
+	}
+
+	/// <summary>
+	/// The pixels NativePlugin.CopyTextureUpdate() copied, and the texture version they bring the texture to
+	/// </summary>
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TextureUpdate
+	{
+		public TextureRect Rect;
+		public uint Version;
+	}
+
+	/// <summary>
+	/// Counters for how much texture data the native plugin rasterized and handed over for upload
+	/// </summary>
+	[StructLayout(LayoutKind.Sequential)]
+	public struct RasterStats
+	{
+		public ulong RasterizedBytes;
+		public ulong UploadedBytes;
+		public ulong FullRasterizations;
+		public ulong PartialRasterizations;
+		public ulong UnchangedRasterizations;
+	}
+
+	/// <summary>
+	/// Pointers to the native arrays indexing a label's clusters in logical order, in render pixels with y
+	/// pointing down. Line i holds clusters LineFirstCluster[i] up to LineFirstCluster[i + 1].
+	/// </summary>
+	[StructLayout(LayoutKind.Sequential)]
+	public struct ClusterGeometryView
+	{
+		public int ClusterCount;
+		public int LineCount;
+		public IntPtr InkRects;
+		public IntPtr ByteIndices;
+		public IntPtr Left;
+		public IntPtr Right;
+		public IntPtr Rtl;
+		public IntPtr VisualToLogical;
+		public IntPtr LogicalToVisual;
+		public IntPtr LineFirstCluster;
+		public IntPtr LineTop;
+		public IntPtr LineBottom;
+	}
+
+	/// <summary>
+	/// The unwrapped size of a string in pixels, as measured by NativePlugin.GetTextSizes()
+	/// </summary>
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TextSize
+	{
+		public int WidthLogical;
+		public int HeightLogical;
+		public int WidthInk;
+		public int HeightInk;
+	}
+
+	/// <summary>
+	/// The arguments of SetTextDataWithFontId() for one label in a NativePlugin.SetTextDataBatch() call.
+	/// Size must be set to Marshal.SizeOf(typeof(TextDataDescriptor)) and Text must point to a null
+	/// terminated UTF-8 string that stays valid during the call.
+	/// </summary>
+	[StructLayout(LayoutKind.Sequential)]
+	public struct TextDataDescriptor
+	{
+		public uint Size;
+		public uint Index;
+		public IntPtr Text;
+		public int FontId;
+		public int FontSize;
+		public int TextBoxWidth;
+		public int TextBoxHeight;
+		public ColorBlock Color;
+		public HorizontalAlignment HorizontalAlignment;
+		public float LineSpacing;
+		public int Justify;
+		public int AutoDirection;
+		public Direction Direction;
+		public VerticalAlignment VerticalAlignment;
+		public HorizontalWrapping WrappingH;
+		public VerticalWrapping WrappingV;
+		public int UseMarkup;
+		public float ResolutionMultiplier;
+		public int AutoPadding;
+		public int PaddingLeft;
+		public int PaddingRight;
+		public int PaddingTop;
+		public int PaddingBottom;
+		/// <summary>Where this label's character rects start in the batch's rects array</summary>
+		public int RectOffset;
+		/// <summary>The number of character rects to write, or 0 to skip them</summary>
+		public int RectCount;
+	}
+
+	/// <summary>
+	/// Whether a label is drawn from its own texture, from glyph quads in the shared glyph atlas, or from a
+	/// signed distance field texture (coverage 0.5 on the glyph edges) that a shader thresholds
+	/// </summary>
+	public enum OutputMode { Texture = 0, GlyphQuads = 1, DistanceField = 2 }
+
+	/// <summary>
+	/// One glyph of a label in the shared glyph atlas. X and Y are the top left corner in render
+	/// pixels with y pointing down. The atlas page holds coverage only, to be tinted by the color.
+	/// </summary>
+	[StructLayout(LayoutKind.Sequential)]
+	public struct GlyphQuad
+	{
+		public float X;
+		public float Y;
+		public float Width;
+		public float Height;
+		public float U0;
+		public float V0;
+		public float U1;
+		public float V1;
+		public float R;
+		public float G;
+		public float B;
+		public float A;
+		public int Page;
+	}
+
+	[StructLayout(LayoutKind.Sequential)]
+	public struct GlyphAtlasInfo
+	{
+		public int PageCount;
+		/// <summary>Pages are PageSize x PageSize, one byte of coverage per texel</summary>
+		public int PageSize;
+		/// <summary>Changes when the atlas is reset, which invalidates all earlier quads</summary>
+		public uint Epoch;
+		/// <summary>Glyphs left out of quads because the atlas was full</summary>
+		public uint DroppedGlyphs;
+	}
+
 	/// <summary>
 	/// Which way the text should run
 	/// </summary>
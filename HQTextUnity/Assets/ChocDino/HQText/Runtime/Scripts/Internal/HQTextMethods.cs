@@ -47,14 +47,15 @@ namespace ChocDino.HQText.Internal
 			return new Vector2Int(Mathf.Max(8, textureSize.x), Mathf.Max(8, textureSize.y));
 		}
 
-		private static Texture2D CreateTexture(int width, int height)
+		private static Texture2D CreateTexture(int width, int height, TextureFormat format)
 		{
 			Debug.Assert(width > 0 && height > 0);
 			Debug.Assert(width <= MaxTextureSize && height <= MaxTextureSize);
 			// TODO: Support an option for generating mip-maps
 			width = Mathf.Clamp(width, 0, MaxTextureSize);
 			height = Mathf.Clamp(height, 0, MaxTextureSize);
-			var result = new Texture2D(width, height, TextureFormat.ARGB32, mipChain:false, linear:false
+			// RGBA32 and Alpha8 match the byte order the native plugin writes, so Unity uploads them as is
+			var result = new Texture2D(width, height, format, mipChain:false, linear:false
 			#if UNITY_2022_1_OR_NEWER
 			, createUninitialized:true
 			#endif
@@ -67,8 +68,17 @@ namespace ChocDino.HQText.Internal
 		}
 
 		/// <summary>
-		/// Creates a texture in the properties object based on a new width and height. If the width and
-		/// height input match the current texture size it does nothing
+		/// The texture format for the label. Single colour labels get Alpha8, and their colour is applied
+		/// with the vertex colour.
+		/// </summary>
+		public static TextureFormat GetTextureFormat(HQTextProperties properties)
+		{
+			return properties.TextInfo.PreferredTextureFormat == RasterFormat.Alpha8 ? TextureFormat.Alpha8 : TextureFormat.RGBA32;
+		}
+
+		/// <summary>
+		/// Creates a texture in the properties object based on a new width, height and the preferred
+		/// format of the label. If they match the current texture it does nothing
 		/// </summary>
 		/// <param name="properties">The input text properties</param>
 		/// <param name="width">The width to test against</param>
@@ -80,14 +90,15 @@ namespace ChocDino.HQText.Internal
 			width = Mathf.Max(8, width);
 			height = Mathf.Max(8, height);
 
+			TextureFormat format = GetTextureFormat(properties);
 			if (properties.Texture == null)
 			{
-				properties.Texture = CreateTexture(width, height);
+				properties.Texture = CreateTexture(width, height, format);
 				return true;
 			}
 
 			// TODO: Use texture pool
-			if (width != properties.Texture.width || height != properties.Texture.height)
+			if (width != properties.Texture.width || height != properties.Texture.height || format != properties.Texture.format)
 			{
 				if (!Application.isPlaying)
 				{
@@ -97,7 +108,7 @@ namespace ChocDino.HQText.Internal
 				{
 					GameObject.Destroy(properties.Texture);
 				}
-				properties.Texture = CreateTexture(width, height);
+				properties.Texture = CreateTexture(width, height, format);
 				return true;
 			}
 			return false;
@@ -61,6 +61,255 @@ namespace ChocDino.HQText.Internal
 												int paddingTop,
 												int paddingBottom);
 
+		/// <summary>
+		/// Sets the text data for a given render instance using a font id from RegisterFont(), which
+		/// avoids looking the font up by name on every update.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern TextInfo SetTextDataWithFontId(uint index,
+												string text,
+												int fontId,
+												int fontSize,
+												int textBoxWidth,
+												int textBoxHeight,
+												ColorBlock color,
+												HorizontalAlignment horizontalAlignment,
+												float lineSpacing,
+												int justify,
+												int autoDirection,
+												Direction direction,
+												VerticalAlignment verticalAlignment,
+												HorizontalWrapping wrappingH,
+												VerticalWrapping wrappingV,
+												int useMarkup,
+												float resolutionMultiplier,
+												int autoPadding,
+												int paddingLeft,
+												int paddingRight,
+												int paddingTop,
+												int paddingBottom);
+
+		/// <summary>
+		/// Queues the same work as SetTextDataWithFontId() on the native layout threads, so many
+		/// labels can be laid out in parallel without blocking the main thread.
+		/// </summary>
+		/// <returns>A ticket to pass to PollLayout()</returns>
+		[DllImport(DllName)]
+		public static extern uint SetTextDataAsync(uint index,
+												string text,
+												int fontId,
+												int fontSize,
+												int textBoxWidth,
+												int textBoxHeight,
+												ColorBlock color,
+												HorizontalAlignment horizontalAlignment,
+												float lineSpacing,
+												int justify,
+												int autoDirection,
+												Direction direction,
+												VerticalAlignment verticalAlignment,
+												HorizontalWrapping wrappingH,
+												VerticalWrapping wrappingV,
+												int useMarkup,
+												float resolutionMultiplier,
+												int autoPadding,
+												int paddingLeft,
+												int paddingRight,
+												int paddingTop,
+												int paddingBottom);
+
+		/// <summary>
+		/// Checks whether the layout queued by SetTextDataAsync() has finished.
+		/// </summary>
+		/// <returns>1 when done (info is filled and the ticket is released), 0 while still queued and -1 for an unknown ticket</returns>
+		[DllImport(DllName)]
+		public static extern int PollLayout(uint ticket, out TextInfo info);
+
+		/// <summary>
+		/// Sets the text data of many labels in one call, e.g. after a language switch. Each label's
+		/// TextInfo is written to infos, and its character rects to rects as given by the descriptor.
+		/// With parallel set the labels are laid out on the native layout threads.
+		/// </summary>
+		/// <returns>The number of labels updated, or -1 if the descriptor size isn't supported</returns>
+		[DllImport(DllName)]
+		public static extern int SetTextDataBatch([In] TextDataDescriptor[] descriptors,
+												int count,
+												[Out] TextInfo[] infos,
+												[Out] Rectangle[] rects,
+												int rectCapacity,
+												int parallel);
+
+		/// <summary>
+		/// Measures count strings in the same font in one call, e.g. a whole column of a localisation table.
+		/// Each string must point to a null terminated UTF-8 string that stays valid during the call. Strings
+		/// that aren't cached yet are measured on the native layout threads.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern void GetTextSizes([In] IntPtr[] strings,
+												int count,
+												int fontId,
+												int fontSize,
+												float lineSpacing,
+												int useMarkup,
+												[Out] TextSize[] sizes);
+
+		/// <summary>
+		/// Registers a font family and face for a backend. Registering the same font again returns the
+		/// same id.
+		/// </summary>
+		/// <returns>The id to pass to SetTextDataWithFontId()</returns>
+		[DllImport(DllName)]
+		public static extern int RegisterFont(string fontname, string fontFace, FontBackend backend);
+
+		/// <summary>
+		/// Per-property updates for an existing render instance. Each only redoes the work the
+		/// property needs, e.g. colour and vertical alignment changes don't re-layout the text.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern TextInfo UpdateText(uint index, string text, int useMarkup);
+
+		/// <summary>
+		/// Adds text to the end of the label's text, e.g. a line of a log. Include the line breaks.
+		/// With a viewport, only the new paragraphs and the text around the viewport are laid out again.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern TextInfo AppendText(uint index, string text);
+
+		/// <summary>
+		/// Removes the first paragraphs of the label's text, e.g. to keep a log to a number of lines.
+		/// The viewport's scroll position is kept, so the text moves up.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern TextInfo TrimText(uint index, int paragraphs);
+
+		[DllImport(DllName)]
+		public static extern TextInfo UpdateFont(uint index, int fontId);
+
+		[DllImport(DllName)]
+		public static extern TextInfo UpdateFontSize(uint index, int fontSize, float resolutionMultiplier);
+
+		[DllImport(DllName)]
+		public static extern TextInfo UpdateColor(uint index, ColorBlock color);
+
+		[DllImport(DllName)]
+		public static extern TextInfo UpdateAlignment(uint index,
+												HorizontalAlignment horizontalAlignment,
+												VerticalAlignment verticalAlignment,
+												int justify);
+
+		[DllImport(DllName)]
+		public static extern TextInfo UpdateWrapping(uint index,
+												int textBoxWidth,
+												int textBoxHeight,
+												HorizontalWrapping wrappingH,
+												VerticalWrapping wrappingV);
+
+		[DllImport(DllName)]
+		public static extern TextInfo UpdatePadding(uint index,
+												int autoPadding,
+												int paddingLeft,
+												int paddingRight,
+												int paddingTop,
+												int paddingBottom);
+
+		/// <summary>
+		/// Switches the texture output between straight alpha (the default) and premultiplied alpha,
+		/// which is cheaper to produce and keeps full precision at low alpha.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern TextInfo UpdatePremultipliedAlpha(uint index, int premultipliedAlpha);
+
+		/// <summary>
+		/// When enabled, labels are rasterized on the native worker threads as soon as their layout
+		/// is ready, so the texture update on the render thread only hands over the finished pixels.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern void SetPreRasterization(int enabled);
+
+		/// <summary>
+		/// Selects whether the label is drawn from its own texture or from GetGlyphQuads().
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern TextInfo UpdateOutputMode(uint index, OutputMode outputMode);
+
+		/// <summary>
+		/// Sets how many pixels the distance field of an OutputMode.DistanceField label spans on each side of
+		/// the glyph edges. The texture is padded by as much.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern TextInfo UpdateDistanceFieldSpread(uint index, float spread);
+
+		/// <summary>
+		/// Shows viewportHeight pixels of a long plain text from scrollY down, so only the text around
+		/// the viewport is laid out and rasterized. Character rects then start at TextInfo.FirstCharacter.
+		/// A viewportHeight of 0 shows the whole text.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern TextInfo UpdateViewport(uint index, int scrollY, int viewportHeight);
+
+		/// <summary>
+		/// Writes up to quads.Length glyph quads for the label and returns how many it needs.
+		/// Upload the atlas pages with CopyGlyphAtlasPage() before drawing them.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern int GetGlyphQuads(uint index, [Out] GlyphQuad[] quads, int capacity);
+
+		[DllImport(DllName)]
+		public static extern void GetGlyphAtlasInfo(ref GlyphAtlasInfo info);
+
+		/// <summary>
+		/// Copies a PageSize x PageSize A8 atlas page to dst and returns its version, which changes
+		/// whenever glyphs are added. Pass IntPtr.Zero to only read the version.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern uint CopyGlyphAtlasPage(int page, IntPtr dst, int dstSize);
+
+		/// <summary>
+		/// Drops every glyph from the atlas, e.g. when GlyphAtlasInfo.DroppedGlyphs is not zero.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern void ResetGlyphAtlas();
+
+		/// <summary>
+		/// Caps how many bytes of texture memory the native plugin keeps around for reuse.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern void SetTextureBufferPoolLimit(ulong limitBytes);
+
+		/// <summary>
+		/// Frees pooled texture memory until at most maxBytes are left, e.g. after a scene change.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern void TrimTextureBufferPool(ulong maxBytes);
+
+		[DllImport(DllName)]
+		public static extern void GetTextureBufferPoolStats(ref TextureBufferPoolStats stats);
+
+		/// <summary>
+		/// Sets how many GetTextSize measurements the native plugin remembers. 0 disables the cache.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern void SetTextSizeCacheCapacity(uint entries);
+
+		[DllImport(DllName)]
+		public static extern void ClearTextSizeCache();
+
+		[DllImport(DllName)]
+		public static extern void GetTextSizeCacheStats(ref TextSizeCacheStats stats);
+
+		/// <summary>
+		/// Copies the pixels of the label's texture that changed since texture version `version` to dst,
+		/// rasterizing only the changed region when possible. Upload update.Rect of dst (e.g. through a
+		/// staging texture and Graphics.CopyTexture) and keep update.Version for the next call. A version
+		/// of 0 copies the whole texture. Returns 0 if the label doesn't exist or dstSize bytes are too
+		/// few for update.Rect.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern int CopyTextureUpdate(uint index, int width, int height, RasterFormat format, uint version, IntPtr dst, int dstSize, out TextureUpdate update);
+
+		[DllImport(DllName)]
+		public static extern void GetRasterStats(ref RasterStats stats);
+
 		/// <summary>
 		/// Create a new native instance  of the plugin. For each Initialize() you need to call a
 		/// Teardown(index) or it will create a memory leak.
@@ -259,5 +508,32 @@ namespace ChocDino.HQText.Internal
 			Marshal.FreeHGlobal(p);
 			return r;
 		}
+
+		/// <summary>
+		/// Points view at the native cluster geometry of the label, which stays valid until the label is next
+		/// updated or torn down.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern int GetClusterGeometry(uint index, ref ClusterGeometryView view);
+
+		/// <summary>
+		/// Returns the cluster at (x, y) in render pixels with y pointing down, or the closest one for points
+		/// outside the text, or -1 if the label is empty.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern int HitTest(uint index, int x, int y);
+
+		/// <summary>
+		/// Gets the zero width caret in front of the cluster. Returns 0 for an unknown cluster.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern int GetCaretRect(uint index, int cluster, ref Rectangle rect);
+
+		/// <summary>
+		/// Writes the rects highlighting clusters start up to end, one per visually contiguous span on each
+		/// line, and returns how many the selection needs.
+		/// </summary>
+		[DllImport(DllName)]
+		public static extern int GetSelectionRects(uint index, int start, int end, [Out] Rectangle[] rects, int capacity);
 	}
 }